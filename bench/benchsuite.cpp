@@ -0,0 +1,425 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+#include <functional>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "imageprocessor.h"
+#include "filters/functionfilters.h"
+#include "filters/convolutionbackend.h"
+#include "filters/parallelexecutor.h"
+
+// Runs every ImageProcessor entry point over synthetic images from 256x256 to
+// 8K and reports the median time, throughput and peak memory of each, for
+// tracking regressions against a saved baseline.
+// Usage: ImageFilteringBenchSuite [--sizes 256,hd,8k] [--json out.json] [--baseline base.json]
+
+struct Size
+{
+    QString name;
+    int width;
+    int height;
+};
+
+struct Case
+{
+    QString name;
+    bool gray; // Runs on the single-channel image
+    std::function<void(const QImage &)> run;
+};
+
+struct Result
+{
+    QString name;
+    Size size;
+    double seconds;      // Median
+    double pixelsPerSecond;
+    qint64 peakBytes;
+};
+
+static const QVector<Size> DefaultSizes = {
+    { "256", 256, 256 },
+    { "512", 512, 512 },
+    { "1024", 1024, 1024 },
+    { "hd", 1920, 1080 },
+    { "4k", 3840, 2160 },
+    { "8k", 7680, 4320 }
+};
+
+// "256" is square, "WxH" any size, or one of the names above
+static bool parseSize(const QString &text, Size &size)
+{
+    for (const Size &known : DefaultSizes) {
+        if (known.name == text.toLower()) {
+            size = known;
+            return true;
+        }
+    }
+    
+    QStringList parts = text.toLower().split('x');
+    bool okWidth = false;
+    bool okHeight = false;
+    int width = parts.value(0).toInt(&okWidth);
+    int height = parts.size() == 2 ? parts[1].toInt(&okHeight) : width;
+    okHeight = parts.size() == 1 ? okWidth : okHeight;
+    if (parts.size() > 2 || !okWidth || !okHeight || width <= 0 || height <= 0) {
+        return false;
+    }
+    size = Size { text, width, height };
+    return true;
+}
+
+// Opaque noise, as a decoded photo would be laid out
+static QImage createTestImage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+    QRandomGenerator generator(12345);
+    
+    for (int y = 0; y < height; ++y) {
+        QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            row[x] = 0xff000000 | generator.generate();
+        }
+    }
+    
+    return image;
+}
+
+// Integer kernel without symmetry, so it takes the generic, non-separable path
+static QVector<QVector<double>> testKernel(int size)
+{
+    QVector<QVector<double>> kernel(size, QVector<double>(size));
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            kernel[y][x] = (x * 7 + y * 3) % 5 + 1;
+        }
+    }
+    return kernel;
+}
+
+// Forget the peak resident set size so far. Only Linux allows it; elsewhere
+// the peak is that of the whole run.
+static bool resetPeakMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/clear_refs");
+    return file.open(QIODevice::WriteOnly) && file.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+// Peak resident set size in bytes, 0 if unknown
+static qint64 peakMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/self/status");
+    if (file.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : file.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) {
+                return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+            }
+        }
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss;
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static QVector<Case> createCases(ImageProcessor &processor)
+{
+    QVector<Case> cases;
+    auto add = [&](const QString &name, const std::function<void(const QImage &)> &run) {
+        cases.append(Case { name, false, run });
+    };
+    auto addGray = [&](const QString &name, const std::function<void(const QImage &)> &run) {
+        cases.append(Case { name + " (gray)", true, run });
+    };
+    
+    // Function filters
+    add("Inversion", [&](const QImage &image) { processor.applyInversion(image); });
+    add("Brightness", [&](const QImage &image) { processor.applyBrightnessCorrection(image, 40.0); });
+    add("Contrast", [&](const QImage &image) { processor.applyContrastEnhancement(image, 1.5); });
+    add("Gamma", [&](const QImage &image) { processor.applyGammaCorrection(image, 2.2); });
+    add("Grayscale", [&](const QImage &image) { processor.applyGrayscale(image); });
+    add("Uniform Quantization", [&](const QImage &image) { processor.applyUniformQuantization(image, 4, 4, 4); });
+    add("Point Chain", [&](const QImage &image) {
+        BrightnessFilter brightness(20.0);
+        ContrastFilter contrast(1.2);
+        GammaFilter gamma(2.2);
+        processor.applyPointFilterChain(image, { &brightness, &contrast, &gamma });
+    });
+    
+    QStringList ditherNames = processor.getDitheringKernelNames();
+    for (int kernel = 0; kernel < ditherNames.size(); ++kernel) {
+        auto type = static_cast<DitheringFilter::KernelType>(kernel);
+        add("Dithering " + ditherNames[kernel], [&processor, type](const QImage &image) {
+            processor.applyDithering(image, 2, 2, 2, type);
+        });
+    }
+    
+    // HSV
+    add("Hue Rotation", [&](const QImage &image) { processor.applyHueRotation(image, 40.0); });
+    add("Saturation", [&](const QImage &image) { processor.applySaturation(image, 1.5); });
+    add("Value", [&](const QImage &image) { processor.applyValueAdjustment(image, 1.2, 0.8); });
+    add("HSV Conversion", [&](const QImage &image) { processor.convertToHSV(image); });
+    add("HSV Round Trip", [&](const QImage &image) {
+        processor.convertToRGB(processor.convertToHSV(image));
+    });
+    
+    // Convolution: the predefined kernels, then generic kernels of growing size
+    add("Blur", [&](const QImage &image) { processor.applyBlur(image); });
+    add("Gaussian Blur", [&](const QImage &image) { processor.applyGaussianBlur(image); });
+    add("Sharpen", [&](const QImage &image) { processor.applySharpen(image); });
+    add("Edge Detection", [&](const QImage &image) { processor.applyEdgeDetection(image); });
+    add("Emboss", [&](const QImage &image) { processor.applyEmboss(image); });
+    for (int size : { 3, 5, 7, 11, 15 }) {
+        QVector<QVector<double>> kernel = testKernel(size);
+        double divisor = processor.getKernelDivisor(kernel);
+        add(QString("Convolution %1x%1").arg(size), [&processor, kernel, divisor](const QImage &image) {
+            processor.applyConvolutionFilter(image, kernel, divisor);
+        });
+    }
+    
+    for (int size : { 3, 5, 7, 9 }) {
+        add(QString("Median %1x%1").arg(size), [&processor, size](const QImage &image) {
+            processor.applyMedianFilter(image, size);
+        });
+    }
+    
+    // The single-channel path GrayscaleFilter's output takes
+    addGray("Gamma", [&](const QImage &image) { processor.applyGammaCorrection(image, 2.2); });
+    addGray("Dithering Floyd-Steinberg", [&](const QImage &image) {
+        processor.applyDithering(image, 2, 2, 2, DitheringFilter::FLOYD_STEINBERG);
+    });
+    addGray("Gaussian Blur", [&](const QImage &image) { processor.applyGaussianBlur(image); });
+    QVector<QVector<double>> grayKernel = testKernel(7);
+    double grayDivisor = processor.getKernelDivisor(grayKernel);
+    addGray("Convolution 7x7", [&processor, grayKernel, grayDivisor](const QImage &image) {
+        processor.applyConvolutionFilter(image, grayKernel, grayDivisor);
+    });
+    addGray("Median 5x5", [&](const QImage &image) { processor.applyMedianFilter(image, 5); });
+    
+    return cases;
+}
+
+// One untimed run first, then the median of the timed ones
+static Result measure(const Case &testCase, const Size &size, const QImage &image, int repetitions)
+{
+    testCase.run(image);
+    
+    resetPeakMemory();
+    
+    QVector<double> times;
+    for (int i = 0; i < repetitions; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        testCase.run(image);
+        times.append(timer.nsecsElapsed() / 1e9);
+    }
+    std::sort(times.begin(), times.end());
+    int middle = times.size() / 2;
+    double median = times.size() % 2 ? times[middle] : (times[middle - 1] + times[middle]) / 2.0;
+    
+    Result result;
+    result.name = testCase.name;
+    result.size = size;
+    result.seconds = median;
+    result.pixelsPerSecond = median > 0.0 ? double(size.width) * size.height / median : 0.0;
+    result.peakBytes = peakMemory();
+    return result;
+}
+
+static QString resultKey(const QString &name, int width, int height)
+{
+    return QString("%1@%2x%3").arg(name).arg(width).arg(height);
+}
+
+// Median seconds by result key
+static bool loadBaseline(const QString &path, QMap<QString, double> &baseline, QString &error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("%1: cannot read").arg(path);
+        return false;
+    }
+    
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (!doc.isObject()) {
+        error = QString("%1: not a benchmark result").arg(path);
+        return false;
+    }
+    
+    for (const QJsonValue &value : doc.object().value("results").toArray()) {
+        QJsonObject entry = value.toObject();
+        baseline.insert(resultKey(entry.value("name").toString(), entry.value("width").toInt(),
+                                  entry.value("height").toInt()),
+                        entry.value("medianMs").toDouble() / 1000.0);
+    }
+    return true;
+}
+
+static bool writeJson(const QString &path, const QVector<Result> &results, int repetitions)
+{
+    QJsonArray entries;
+    for (const Result &result : results) {
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["width"] = result.size.width;
+        entry["height"] = result.size.height;
+        entry["medianMs"] = result.seconds * 1000.0;
+        entry["pixelsPerSecond"] = result.pixelsPerSecond;
+        entry["peakRssBytes"] = double(result.peakBytes);
+        entries.append(entry);
+    }
+    
+    QJsonObject object;
+    object["threads"] = ParallelExecutor::workerCount();
+    object["convolutionBackend"] = ConvolutionBackend::getName(ConvolutionBackend::active());
+    object["repetitions"] = repetitions;
+    object["results"] = entries;
+    
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(object).toJson()) >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ImageFilteringBenchSuite");
+    
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times every filter over a range of image sizes.");
+    parser.addHelpOption();
+    
+    QCommandLineOption sizesOption("sizes",
+        "Comma-separated sizes: N for NxN, WxH, hd, 4k or 8k. Default: 256 to 8k.", "list");
+    QCommandLineOption repetitionsOption({ "r", "repetitions" }, "Timed runs per case.", "count", "5");
+    QCommandLineOption onlyOption("only", "Run only the cases whose name contains this text.", "text");
+    QCommandLineOption jsonOption("json", "Write the results to a JSON file.", "file");
+    QCommandLineOption baselineOption("baseline", "Compare against the JSON results of an earlier run.", "file");
+    QCommandLineOption toleranceOption("tolerance",
+        "Slowdown against the baseline, in percent, reported as a regression.", "percent", "10");
+    QCommandLineOption listOption("list", "List the cases.");
+    parser.addOptions({ sizesOption, repetitionsOption, onlyOption, jsonOption, baselineOption,
+                        toleranceOption, listOption });
+    parser.process(app);
+    
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    
+    ImageProcessor processor;
+    QVector<Case> cases;
+    for (const Case &testCase : createCases(processor)) {
+        if (testCase.name.contains(parser.value(onlyOption), Qt::CaseInsensitive)) {
+            cases.append(testCase);
+        }
+    }
+    
+    if (parser.isSet(listOption)) {
+        for (const Case &testCase : cases) {
+            out << testCase.name << "\n";
+        }
+        return 0;
+    }
+    
+    QVector<Size> sizes = DefaultSizes;
+    if (parser.isSet(sizesOption)) {
+        sizes.clear();
+        for (const QString &text : parser.value(sizesOption).split(',', Qt::SkipEmptyParts)) {
+            Size size;
+            if (!parseSize(text.trimmed(), size)) {
+                err << QString("invalid size '%1'\n").arg(text);
+                return 1;
+            }
+            sizes.append(size);
+        }
+    }
+    
+    QMap<QString, double> baseline;
+    if (parser.isSet(baselineOption)) {
+        QString error;
+        if (!loadBaseline(parser.value(baselineOption), baseline, error)) {
+            err << error << "\n";
+            return 1;
+        }
+    }
+    
+    int repetitions = qMax(1, parser.value(repetitionsOption).toInt());
+    double tolerance = parser.value(toleranceOption).toDouble() / 100.0;
+    
+    out << QString("Median of %1, %2 threads, %3 convolution, peak RSS %4\n")
+               .arg(repetitions)
+               .arg(ParallelExecutor::workerCount())
+               .arg(ConvolutionBackend::getName(ConvolutionBackend::active()))
+               .arg(resetPeakMemory() ? "per case" : "of the whole run");
+    
+    QVector<Result> results;
+    int regressions = 0;
+    for (const Size &size : sizes) {
+        QImage image = createTestImage(size.width, size.height);
+        QImage gray = processor.applyGrayscale(image);
+        
+        out << QString("\n%1x%2\n").arg(size.width).arg(size.height);
+        for (const Case &testCase : cases) {
+            Result result = measure(testCase, size, testCase.gray ? gray : image, repetitions);
+            results.append(result);
+            
+            QString comparison;
+            QString key = resultKey(result.name, size.width, size.height);
+            if (baseline.contains(key) && baseline.value(key) > 0.0) {
+                double change = result.seconds / baseline.value(key) - 1.0;
+                comparison = QString("%1%").arg(change * 100.0, 7, 'f', 1);
+                if (change > tolerance) {
+                    comparison += "  REGRESSION";
+                    ++regressions;
+                }
+            } else if (!baseline.isEmpty()) {
+                comparison = "    new";
+            }
+            
+            out << QString("%1 %2 ms %3 Mpixels/s %4 MB %5\n")
+                       .arg(result.name, -30)
+                       .arg(result.seconds * 1000.0, 10, 'f', 2)
+                       .arg(result.pixelsPerSecond / 1e6, 9, 'f', 1)
+                       .arg(result.peakBytes / double(1 << 20), 8, 'f', 1)
+                       .arg(comparison);
+            out.flush();
+        }
+    }
+    
+    if (parser.isSet(jsonOption) && !writeJson(parser.value(jsonOption), results, repetitions)) {
+        err << QString("%1: cannot write\n").arg(parser.value(jsonOption));
+        return 1;
+    }
+    
+    if (!baseline.isEmpty()) {
+        out << QString("\n%1 regression(s) beyond %2%\n").arg(regressions).arg(tolerance * 100.0);
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTextStream>
+#include <functional>
+
+#include "imageprocessor.h"
+#include "filters/pixelview.h"
+#include "filters/convolutionbackend.h"
+#include "filters/parallelexecutor.h"
+
+// Measures filter throughput in pixels per second on a synthetic image.
+// Usage: ImageFilteringBench [width] [height] [repetitions]
+
+static QImage createTestImage(int width, int height)
+{
+    QImage image(width, height, QImage::Format_ARGB32);
+    QRandomGenerator generator(12345);
+    
+    for (int y = 0; y < height; ++y) {
+        QRgb *row = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            row[x] = generator.generate();
+        }
+    }
+    
+    return image;
+}
+
+// Best-of-N wall time in seconds
+static double measure(int repetitions, const std::function<void()> &run)
+{
+    double best = 0.0;
+    for (int i = 0; i < repetitions; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        double seconds = timer.nsecsElapsed() / 1e9;
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+// Inversion through QImage::pixel()/setPixel(), the access pattern filters used before PixelView
+static QImage invertPerPixel(const QImage &image)
+{
+    QImage result = image.copy();
+    for (int y = 0; y < result.height(); ++y) {
+        for (int x = 0; x < result.width(); ++x) {
+            QRgb pixel = image.pixel(x, y);
+            result.setPixel(x, y, qRgba(255 - qRed(pixel), 255 - qGreen(pixel), 255 - qBlue(pixel), qAlpha(pixel)));
+        }
+    }
+    return result;
+}
+
+// The same inversion through PixelView rows
+static QImage invertScanline(const QImage &image)
+{
+    ConstPixelView src(image);
+    QImage result = PixelView::createResult(src);
+    PixelView dst(result);
+    for (int y = 0; y < src.height(); ++y) {
+        const QRgb *in = src.row(y);
+        QRgb *out = dst.row(y);
+        for (int x = 0; x < src.width(); ++x) {
+            QRgb pixel = in[x];
+            out[x] = qRgba(255 - qRed(pixel), 255 - qGreen(pixel), 255 - qBlue(pixel), qAlpha(pixel));
+        }
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    
+    int width = args.size() > 1 ? args[1].toInt() : 4096;
+    int height = args.size() > 2 ? args[2].toInt() : 4096;
+    int repetitions = args.size() > 3 ? args[3].toInt() : 3;
+    
+    QImage image = createTestImage(width, height);
+    ImageProcessor processor;
+    double pixels = static_cast<double>(width) * height;
+    
+    QTextStream out(stdout);
+    out << QString("Image %1x%2, best of %3, %4 threads, %5 convolution\n")
+               .arg(width).arg(height).arg(repetitions)
+               .arg(ParallelExecutor::workerCount())
+               .arg(ConvolutionBackend::getName(ConvolutionBackend::active()));
+    
+    auto report = [&](const QString &name, const std::function<void()> &run) {
+        double seconds = measure(repetitions, run);
+        out << QString("%1 %2 ms %3 Mpixels/s\n")
+                   .arg(name, -28)
+                   .arg(seconds * 1000.0, 10, 'f', 1)
+                   .arg(pixels / seconds / 1e6, 10, 'f', 1);
+        out.flush();
+    };
+    
+    // Access layer: before and after
+    report("access pixel()/setPixel()", [&]() { invertPerPixel(image); });
+    report("access PixelView", [&]() { invertScanline(image); });
+    
+    // Filters
+    report("Inversion", [&]() { processor.applyInversion(image); });
+    report("Brightness", [&]() { processor.applyBrightnessCorrection(image, 40.0); });
+    report("Contrast", [&]() { processor.applyContrastEnhancement(image, 1.5); });
+    report("Gamma", [&]() { processor.applyGammaCorrection(image, 2.2); });
+    report("Grayscale", [&]() { processor.applyGrayscale(image); });
+    report("Uniform Quantization", [&]() { processor.applyUniformQuantization(image, 4, 4, 4); });
+    report("Dithering", [&]() { processor.applyDithering(image, 2, 2, 2, DitheringFilter::FLOYD_STEINBERG); });
+    report("Blur", [&]() { processor.applyBlur(image); });
+    report("Gaussian Blur", [&]() { processor.applyGaussianBlur(image); });
+    report("Sharpen", [&]() { processor.applySharpen(image); });
+    report("Edge Detection", [&]() { processor.applyEdgeDetection(image); });
+    report("Emboss", [&]() { processor.applyEmboss(image); });
+    
+    // The Sharpen kernel as a custom kernel, on the generic path
+    QVector<QVector<double>> sharpenKernel = processor.getSharpenKernel();
+    report("Sharpen (generic)", [&]() { processor.applyConvolutionFilter(image, sharpenKernel); });
+    report("Median 3x3", [&]() { processor.applyMedianFilter(image, 3); });
+    report("HSV round trip", [&]() { processor.convertToRGB(processor.convertToHSV(image)); });
+    report("Hue Rotation", [&]() { processor.applyHueRotation(image, 40.0); });
+    report("Saturation", [&]() { processor.applySaturation(image, 1.5); });
+    
+    // The same filters on the single-channel image GrayscaleFilter produces
+    QImage gray = processor.applyGrayscale(image.convertToFormat(QImage::Format_RGB32));
+    report("Gamma (gray)", [&]() { processor.applyGammaCorrection(gray, 2.2); });
+    report("Dithering (gray)", [&]() { processor.applyDithering(gray, 2, 2, 2, DitheringFilter::FLOYD_STEINBERG); });
+    report("Gaussian Blur (gray)", [&]() { processor.applyGaussianBlur(gray); });
+    report("Sharpen (gray)", [&]() { processor.applySharpen(gray); });
+    report("Median 3x3 (gray)", [&]() { processor.applyMedianFilter(gray, 3); });
+    
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef BATCHPIPELINE_H
+#define BATCHPIPELINE_H
+
+#include <QDir>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "filters/filtergraph.h"
+#include "filters/filterregistry.h"
+
+// Filters image files in three overlapping stages, each with its own
+// workers: decoding, the filters, and encoding. Bounded queues between
+// the stages hold the decoded images; a stage that gets ahead waits for room,
+// so codec and file work overlaps filtering with a fixed number of images in
+// memory.
+class BatchPipeline
+{
+public:
+    enum Stage {
+        DECODE,
+        FILTER,
+        ENCODE
+    };
+    
+    BatchPipeline();
+    
+    // What the filter stage runs: a chain of steps, or a whole graph
+    void setFilters(const QVector<FilterStep> &chain);
+    void setGraph(const FilterGraph &graph);
+    
+    // Results keep the input's base name; format is the output suffix, or
+    // empty to keep the input's
+    void setOutput(const QDir &directory, const QString &format = QString());
+    
+    void setWorkerCount(Stage stage, int count);
+    int workerCount(Stage stage) const;
+    
+    // Images each queue holds before the stage feeding it waits
+    void setQueueCapacity(int images);
+    int getQueueCapacity() const;
+    
+    // Most decoded images held at once: one per worker plus the queues
+    int maxImagesInFlight() const;
+    
+    // Process every input. Returns the number of images written and appends
+    // a message per failure to errors. An input whose result would have the
+    // path of an input file, or of an earlier input's result, is not
+    // processed and counts as a failure.
+    int run(const QStringList &inputs, QStringList &errors);
+
+private:
+    QString outputPath(const QString &input) const;
+    
+    FilterGraph graph;
+    QDir outputDir;
+    QString format;
+    int workers[3];
+    int queueCapacity;
+};
+
+#endif // BATCHPIPELINE_H
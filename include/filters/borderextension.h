@@ -0,0 +1,48 @@
+#ifndef BORDEREXTENSION_H
+#define BORDEREXTENSION_H
+
+#include <QImage>
+
+// How neighbourhood filters read past the edges of an image. Filters copy
+// each source row they need once into a padded row through extendRow(), so
+// their taps run without bounds checks. Positions any distance outside the
+// image are valid, including for kernels larger than the image.
+class BorderExtension
+{
+public:
+    enum Mode {
+        MIRROR,   // Reflect at the edges: -1 reads 1 and size reads size - 1
+        CLAMP,    // Repeat the edge pixel
+        WRAP,     // Continue from the opposite edge
+        CONSTANT  // Read a fixed colour
+    };
+    
+    BorderExtension(Mode mode = MIRROR, QRgb color = qRgb(0, 0, 0));
+    
+    Mode getMode() const;
+    QRgb getColor() const;
+    
+    // False when CONSTANT reads a colour whose channels differ, which brings
+    // colour into a gray image
+    bool isGray() const;
+    
+    // Source index of position i along a dimension of size; -1 where
+    // CONSTANT reads the colour
+    int sourceIndex(int i, int size) const;
+    
+    // Fill padded columns [0, length) from a source row of width pixels;
+    // column p holds position p - left. Gray rows read the gray level of the
+    // colour.
+    void extendRow(const QRgb *row, int width, int left, int length, QRgb *out) const;
+    void extendRow(const uchar *row, int width, int left, int length, uchar *out) const;
+    
+    // Fill a row with the colour, for the rows CONSTANT reads outside the image
+    void fillConstant(QRgb *out, int length) const;
+    void fillConstant(uchar *out, int length) const;
+    
+private:
+    Mode mode;
+    QRgb color;
+};
+
+#endif // BORDEREXTENSION_H
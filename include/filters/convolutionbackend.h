@@ -0,0 +1,56 @@
+#ifndef CONVOLUTIONBACKEND_H
+#define CONVOLUTIONBACKEND_H
+
+#include <QImage>
+#include <QString>
+
+// Inner loops of ConvolutionFilter, vectorized for the host CPU.
+// The backend is picked at runtime from CPUID. All backends perform the same
+// IEEE operations in the same order (no fused multiply-add), so their results
+// are bit-identical and can be checked against each other.
+class ConvolutionBackend
+{
+public:
+    enum Type {
+        AUTO,   // Best backend the CPU supports
+        SCALAR, // Portable C++ loops
+        SSE2,   // 4 floats per instruction
+        AVX2    // 8 floats per instruction
+    };
+    
+    // Force a backend (AUTO restores detection). The IMAGEFILTERING_SIMD
+    // environment variable (scalar, sse2, avx2) sets the initial choice.
+    // Unsupported backends fall back to the best supported one below them.
+    static void setForced(Type type);
+    static Type forced();
+    
+    // Backend that accumulate() and pack() currently run on
+    static Type active();
+    static bool isSupported(Type type);
+    static QString getName(Type type);
+    
+    // acc[i] += src[i] * weight for i in [0, count)
+    static void accumulate(float *acc, const float *src, float weight, int count);
+    
+    // out[i] = RGB of planes[c][i] / divisor + offset, truncated and clamped
+    // to 0..255, with the alpha of alphaSource[i]
+    static void pack(const float *red, const float *green, const float *blue,
+                     const QRgb *alphaSource, QRgb *out, int count,
+                     double divisor, double offset);
+    
+    // out[i] = sums[i] / divisor + offset, truncated and clamped to 0..255;
+    // the single-channel form of pack()
+    static void packGray(const float *sums, uchar *out, int count,
+                         double divisor, double offset);
+    
+    // Double forms of the above, for sums past the integers float holds
+    // exactly (2^24). They run the portable loops on every backend.
+    static void accumulate(double *acc, const double *src, double weight, int count);
+    static void pack(const double *red, const double *green, const double *blue,
+                     const QRgb *alphaSource, QRgb *out, int count,
+                     double divisor, double offset);
+    static void packGray(const double *sums, uchar *out, int count,
+                         double divisor, double offset);
+};
+
+#endif // CONVOLUTIONBACKEND_H
@@ -4,6 +4,12 @@
 #include <QImage>
 #include <QString>
 #include <QVector>
+#include "filters/borderextension.h"
+
+class ConstPixelView;
+class PixelView;
+class ConstGrayView;
+class GrayView;
 
 // Base class for all convolution filters
 class ConvolutionFilter
@@ -31,11 +37,44 @@ public:
     int getAnchorY() const;
     void setAnchorY(int y);
     
+    // How taps past the image edges are read; MIRROR by default. The colour
+    // is used by CONSTANT. Single-channel gray images read its gray level, so
+    // they stay gray; other images, even gray ones, read the colour itself.
+    BorderExtension::Mode getBoundaryMode() const;
+    QRgb getBoundaryColor() const;
+    void setBoundaryMode(BorderExtension::Mode mode, QRgb color = qRgb(0, 0, 0));
+    
     virtual QImage apply(const QImage &image);
     
     // Calculate sum of kernel elements
     double calculateKernelSum() const;
     
+    // A separable (rank-1) kernel is the outer product of a column and a row
+    // vector and runs as a horizontal pass followed by a vertical pass
+    bool isSeparable() const;
+    
+    // Disable to force the full 2D path, e.g. to compare the two
+    void setSeparableEnabled(bool enabled);
+    bool isSeparableEnabled() const;
+    
+    // Large kernels that are not separable are convolved in the frequency
+    // domain, in FFT tiles, once their size reaches frequencyThreshold().
+    // Integer kernels give the same result as the spatial path; others may
+    // differ by one level per channel where the sum is within rounding
+    // error of a level boundary.
+    bool usesFrequencyDomain() const;
+    
+    // Disable to force the spatial path
+    void setFrequencyDomainEnabled(bool enabled);
+    bool isFrequencyDomainEnabled() const;
+    
+    // Kernel size (rows x columns) from which the FFT path pays off. It is
+    // measured on first use unless set here or through the
+    // IMAGEFILTERING_FFT_THRESHOLD environment variable; a negative value
+    // restores the measurement.
+    static void setFrequencyThreshold(int taps);
+    static int frequencyThreshold();
+
 protected:
     QString name;
     QVector<QVector<double>> kernel;
@@ -43,10 +82,50 @@ protected:
     double offset;
     int anchorX;
     int anchorY;
+    BorderExtension border;
+    
+    // Rank-1 factorization, valid when separable is set
+    bool separable;
+    bool separableEnabled;
+    QVector<double> columnFactors; // Kernel column through the largest coefficient
+    QVector<double> rowFactors;    // Kernel row through it, divided by that coefficient
+    
+    bool frequencyEnabled;
     
-    // Helper methods
-    QRgb applyToPixel(const QImage &image, int x, int y);
-    QRgb getPixelWithBoundary(const QImage &image, int x, int y);
+    // Predefined filters set this to a convolution compiled for their fixed
+    // integer kernel, which the filter uses while its kernel, divisor, offset
+    // and anchor are still the preset's. The results are the same as on the
+    // generic paths.
+    struct FixedKernel;
+    const FixedKernel *fixedKernel;
+    bool usesFixedKernel() const;
+    template <typename Kernel>
+    static const FixedKernel *fixedKernelFor();
+    
+    // Helper methods. Both paths work on planar rows (R, G and B planes, or
+    // one gray plane) so the taps run through the vectorized
+    // ConvolutionBackend. Source and Target are ConstPixelView and PixelView,
+    // or ConstGrayView and GrayView. Sum is float, or double for kernels
+    // whose sums float would round.
+    int maxKernelWidth() const;
+    
+    // True when the sum of |weight| * 255 reaches 2^24, past which float
+    // sums of integer kernels are no longer exact
+    bool needsDoubleSums() const;
+    
+    void detectSeparability();
+    template <typename Source, typename Target>
+    void applyToView(const Source &src, Target &dst);
+    template <typename Sum, typename Source, typename Target>
+    void applyDirect(const Source &src, Target &dst, int firstRow, int endRow);
+    template <typename Sum, typename Source, typename Target>
+    void applySeparable(const Source &src, Target &dst, int firstRow, int endRow);
+    template <typename Sum>
+    void filterRowHorizontally(const Sum *padded, int length, int width, int channels, Sum *line);
+    void applyFrequency(const ConstPixelView &src, PixelView &dst);
+    void applyFrequency(const ConstGrayView &src, GrayView &dst);
+    
+    static int measureFrequencyThreshold();
 };
 
 // Blur filter
@@ -88,6 +167,14 @@ public:
 class MedianFilter
 {
 public:
+    // All methods give identical results
+    enum Method {
+        AUTOMATIC, // Pick the fastest method for the size
+        SORT,      // Sort every neighbourhood
+        HISTOGRAM, // Sliding column histograms, constant time per pixel
+        NETWORK    // Min/max sorting networks for sizes 3 and 5; other sizes use HISTOGRAM
+    };
+    
     MedianFilter(int size = 3);
     ~MedianFilter();
     
@@ -95,15 +182,34 @@ public:
     int getSize() const;
     void setSize(int size);
     
-    QImage apply(const QImage &image);
+    Method getMethod() const;
+    void setMethod(Method method);
+    
+    // How windows past the image edges are read; MIRROR by default. As for
+    // ConvolutionFilter, CONSTANT reads the gray level of the colour in
+    // single-channel gray images and the colour itself in others.
+    BorderExtension::Mode getBoundaryMode() const;
+    QRgb getBoundaryColor() const;
+    void setBoundaryMode(BorderExtension::Mode mode, QRgb color = qRgb(0, 0, 0));
     
+    QImage apply(const QImage &image);
+
 private:
     QString name;
     int size;
+    Method method;
+    BorderExtension border;
     
-    // Helper methods
-    QRgb applyToPixel(const QImage &image, int x, int y);
-    QRgb getPixelWithBoundary(const QImage &image, int x, int y);
+    // Helper methods, for ConstPixelView and PixelView or ConstGrayView and GrayView.
+    // All of them read padded rows built through border.
+    template <typename Source, typename Target>
+    void applyToView(const Source &src, Target &dst);
+    template <typename Source, typename Target>
+    void applySort(const Source &src, Target &dst, int firstRow, int endRow);
+    template <typename Source, typename Target>
+    void applyHistogram(const Source &src, Target &dst, int firstRow, int endRow);
+    template <typename Source, typename Target>
+    void applyNetwork(const Source &src, Target &dst, int firstRow, int endRow);
 };
 
 // Custom filter
@@ -0,0 +1,79 @@
+#ifndef FILTERGRAPH_H
+#define FILTERGRAPH_H
+
+#include <QImage>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include "filters/filterregistry.h"
+
+// A filter graph read from JSON: named nodes, each a FilterRegistry
+// operation or a "blend" of two inputs, joined by edges. The image being
+// filtered is the node "input"; several nodes may read the same one.
+//
+//   {
+//       "name": "sketch",
+//       "nodes": [
+//           { "id": "gray", "filter": "grayscale" },
+//           { "id": "edges", "filter": "edge-detection" },
+//           { "id": "soft", "filter": "gaussian-blur", "params": { "border": "clamp" } },
+//           { "id": "mix", "filter": "blend", "params": { "weight": 0.3 } }
+//       ],
+//       "edges": [
+//           { "from": "input", "to": "gray" },
+//           { "from": "gray", "to": "edges" },
+//           { "from": "gray", "to": "soft" },
+//           { "from": "edges", "to": "mix" },
+//           { "from": "soft", "to": "mix" }
+//       ],
+//       "output": "mix"
+//   }
+//
+// A blend gives (1 - weight) * first + weight * second, its inputs in the
+// order of their edges. "output" may be left out when only one node has no
+// consumers.
+class FilterGraph
+{
+public:
+    FilterGraph();
+    
+    // Invalid graph with error set on failure
+    static FilterGraph fromJson(const QJsonObject &object, QString &error);
+    QJsonObject toJson() const;
+    
+    // A chain of steps as a graph, each step reading the one before
+    static FilterGraph fromSteps(const QVector<FilterStep> &steps);
+    
+    // Graph files hold nodes; custom kernel files in the same place do not
+    static bool isGraph(const QJsonObject &object);
+    
+    bool isValid() const;
+    QString getName() const;
+    void setName(const QString &name);
+    int nodeCount() const;
+    
+    // Run the graph. Nodes whose inputs are ready run side by side, and each
+    // intermediate image is released when its last consumer has finished.
+    // Returns a null image if the running FilterJob was cancelled.
+    QImage apply(const QImage &image) const;
+
+private:
+    struct Node
+    {
+        QString id;
+        FilterStep step;       // Unused by blends
+        bool blend;
+        double weight;         // Blends only
+        QVector<int> inputs;   // Node indices; Source for the graph input
+    };
+    
+    static const int Source = -1;
+    
+    QString name;
+    QVector<Node> nodes; // Every node after the nodes it reads
+    int output;
+    
+    static QImage blend(const QImage &first, const QImage &second, double weight);
+};
+
+#endif // FILTERGRAPH_H
@@ -0,0 +1,55 @@
+#ifndef FILTERJOB_H
+#define FILTERJOB_H
+
+#include <QAtomicInt>
+#include <functional>
+
+// Progress and cancellation of one filter run, usually on a worker thread.
+// A Scope makes the job current on its thread. ParallelExecutor carries it
+// to its helper threads, counts the work items they finish and stops handing
+// out new ones once the job is cancelled; long row loops also poll
+// isCancelled(). A cancelled run returns an unfinished image to be discarded.
+class FilterJob
+{
+public:
+    FilterJob();
+    
+    // Both are safe to call from any thread
+    void cancel();
+    bool isCancelRequested() const;
+    
+    // Called with the finished percentage of the announced work whenever it
+    // changes, on whichever thread finished the work. Set it before the run.
+    void setProgressHandler(const std::function<void(int)> &handler);
+    
+    // Work items announced and finished, from ParallelExecutor
+    void addWork(int items);
+    void finishWork(int items);
+    
+    // Job of the calling thread, or nullptr
+    static FilterJob *current();
+    
+    // True when the job of the calling thread has been cancelled
+    static bool isCancelled();
+    
+    // Makes a job current on the calling thread while it lives; nullptr
+    // runs the enclosed work outside any job
+    class Scope
+    {
+    public:
+        explicit Scope(FilterJob *job);
+        ~Scope();
+    
+    private:
+        FilterJob *previous;
+    };
+
+private:
+    QAtomicInt cancelled;
+    QAtomicInt total;
+    QAtomicInt finished;
+    QAtomicInt percent;
+    std::function<void(int)> progressHandler;
+};
+
+#endif // FILTERJOB_H
@@ -0,0 +1,77 @@
+#ifndef FILTERREGISTRY_H
+#define FILTERREGISTRY_H
+
+#include <QImage>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include <limits>
+
+// Every filter by name, with named parameters, for callers that pick filters
+// from text such as the command line. Operations run the same filter classes
+// as ImageProcessor.
+class FilterRegistry
+{
+public:
+    struct Parameter
+    {
+        QString name;
+        QJsonValue defaultValue; // A number, a choice name, or a kernel (array of rows)
+        QStringList choices;     // Accepted names when the value is a choice
+        QString description;
+        
+        // Accepted range of a number
+        double minimum = std::numeric_limits<double>::lowest();
+        double maximum = std::numeric_limits<double>::max();
+    };
+    
+    struct Operation
+    {
+        QString name;
+        QString description;
+        QVector<Parameter> parameters;
+        
+        // Run the filter with complete, checked parameters
+        std::function<QImage(const QImage &, const QJsonObject &)> apply;
+        
+        // Optional check across parameters, each already in range
+        std::function<bool(const QJsonObject &, QString &)> check = nullptr;
+    };
+    
+    static const QVector<Operation> &operations();
+    static const Operation *find(const QString &name);
+    
+    // Check given parameters against the operation and fill in the defaults.
+    // Numbers and kernels may also be given as text ("1 2 1; 2 4 2; 1 2 1").
+    // Numbers outside their range are rejected.
+    static bool resolve(const Operation &operation, const QJsonObject &given,
+                        QJsonObject &parameters, QString &error);
+};
+
+// One configured filter: an operation and its complete parameters
+class FilterStep
+{
+public:
+    FilterStep();
+    
+    // From a name and parameters; an invalid step on error
+    static FilterStep create(const QString &name, const QJsonObject &parameters, QString &error);
+    
+    // From "name", "name:value,value" or "name:key=value,key=value"
+    static FilterStep parse(const QString &spec, QString &error);
+    
+    bool isValid() const;
+    QString getName() const;
+    QJsonObject getParameters() const;
+    
+    QImage apply(const QImage &image) const;
+
+private:
+    const FilterRegistry::Operation *operation;
+    QJsonObject parameters;
+};
+
+#endif // FILTERREGISTRY_H
@@ -0,0 +1,42 @@
+#ifndef FOURIERTRANSFORM_H
+#define FOURIERTRANSFORM_H
+
+#include <complex>
+#include <vector>
+
+// Radix-2 complex FFT on square power-of-two arrays, used by the
+// frequency-domain convolution path. Transforms are unscaled: an inverse
+// after a forward multiplies the data by size * size.
+class FourierTransform
+{
+public:
+    typedef std::complex<double> Complex;
+    
+    // size must be a power of two
+    explicit FourierTransform(int size);
+    
+    int getSize() const;
+    
+    // In-place transforms of one row of size elements
+    void forward(Complex *data) const;
+    void inverse(Complex *data) const;
+    
+    // In-place transforms of a size x size row-major array
+    void forward2D(Complex *data) const;
+    void inverse2D(Complex *data) const;
+    
+    static Complex multiply(const Complex &a, const Complex &b);
+    static bool isPowerOfTwo(int value);
+    static int nextPowerOfTwo(int value);
+    
+private:
+    int size;
+    std::vector<int> bitReverse;
+    std::vector<Complex> twiddles;        // Per stage: exp(-2*pi*i*k/length)
+    std::vector<Complex> inverseTwiddles; // Their conjugates
+    
+    void transform(Complex *data, bool inverse) const;
+    void transform2D(Complex *data, bool inverse) const;
+};
+
+#endif // FOURIERTRANSFORM_H
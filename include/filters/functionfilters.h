@@ -6,6 +6,14 @@
 #include <functional>
 #include <QVector>
 
+// Per-channel transfer curve of a point filter, indexed by the 8-bit input value
+struct LookupTable
+{
+    uchar red[256];
+    uchar green[256];
+    uchar blue[256];
+};
+
 // Base class for all function filters
 class FunctionFilter
 {
@@ -16,9 +24,22 @@ public:
     QString getName() const;
     virtual QImage apply(const QImage &image) = 0;
     
+    // Point filters map every channel value on its own, so their whole effect
+    // is a lookup table. Filters that mix channels or neighbours return false.
+    virtual bool isPointOperation() const;
+    virtual LookupTable buildLookupTable() const;
+    
 protected:
     QString name;
-    QRgb applyToPixel(QRgb pixel, std::function<int(int)> func);
+    
+    // Fill a 256-entry channel table from func, clamped to 0..255
+    static void fillChannel(uchar *table, const std::function<int(int)> &func);
+    
+    // Fill all three channel tables with the same curve
+    static void fillChannels(LookupTable &lut, const std::function<int(int)> &func);
+    
+    // Map every pixel of the image through the table, keeping alpha
+    static QImage applyLookupTable(const QImage &image, const LookupTable &lut);
 };
 
 // Inversion filter
@@ -27,6 +48,8 @@ class InversionFilter : public FunctionFilter
 public:
     InversionFilter();
     QImage apply(const QImage &image) override;
+    bool isPointOperation() const override;
+    LookupTable buildLookupTable() const override;
 };
 
 // Brightness correction filter
@@ -35,6 +58,8 @@ class BrightnessFilter : public FunctionFilter
 public:
     BrightnessFilter(double factor = 50.0);
     QImage apply(const QImage &image) override;
+    bool isPointOperation() const override;
+    LookupTable buildLookupTable() const override;
     void setFactor(double factor);
     double getFactor() const;
     
@@ -48,6 +73,8 @@ class ContrastFilter : public FunctionFilter
 public:
     ContrastFilter(double factor = 1.0);
     QImage apply(const QImage &image) override;
+    bool isPointOperation() const override;
+    LookupTable buildLookupTable() const override;
     void setFactor(double factor);
     double getFactor() const;
     
@@ -61,6 +88,8 @@ class GammaFilter : public FunctionFilter
 public:
     GammaFilter(double gamma = 1.0);
     QImage apply(const QImage &image) override;
+    bool isPointOperation() const override;
+    LookupTable buildLookupTable() const override;
     void setGamma(double gamma);
     double getGamma() const;
     
@@ -68,6 +97,25 @@ private:
     double gamma; // Range: 0.1 to 10.0
 };
 
+// Ordered chain of point filters fused into a single lookup table
+class PointFilterChain : public FunctionFilter
+{
+public:
+    PointFilterChain();
+    QImage apply(const QImage &image) override;
+    bool isPointOperation() const override;
+    LookupTable buildLookupTable() const override;
+    
+    // Append a filter after the current ones; returns false if it is not a point operation
+    bool append(const FunctionFilter &filter);
+    int size() const;
+    void clear();
+    
+private:
+    LookupTable lut; // Composition of all appended curves
+    int count;
+};
+
 // Grayscale filter
 class GrayscaleFilter : public FunctionFilter
 {
@@ -82,6 +130,8 @@ class UniformQuantizationFilter : public FunctionFilter
 public:
     UniformQuantizationFilter(int rLevels = 8, int gLevels = 8, int bLevels = 8);
     QImage apply(const QImage &image) override;
+    bool isPointOperation() const override;
+    LookupTable buildLookupTable() const override;
     void setLevels(int rLevels, int gLevels, int bLevels);
     int getRedLevels() const;
     int getGreenLevels() const;
@@ -91,6 +141,9 @@ private:
     int rLevels; // Number of levels for red channel
     int gLevels; // Number of levels for green channel
     int bLevels; // Number of levels for blue channel
+    
+    // Quantize a channel value to the center of its level
+    static int quantizeChannel(int value, int levels);
 };
 
 // Dithering filter with error diffusion
@@ -103,7 +156,13 @@ public:
         BURKES,
         STUCKI,
         SIERRA,
-        ATKINSON
+        ATKINSON,
+        // Threshold matrices: every pixel is independent, so these run fully in parallel
+        BAYER_2X2,
+        BAYER_4X4,
+        BAYER_8X8,
+        BAYER_16X16,
+        BLUE_NOISE
     };
     
     DitheringFilter(int rLevels = 2, int gLevels = 2, int bLevels = 2, KernelType kernelType = FLOYD_STEINBERG);
@@ -120,6 +179,9 @@ public:
     // Get kernel type as string for UI
     static QStringList getKernelNames();
     
+    // True for the error diffusion kernels, false for the threshold matrices
+    static bool isErrorDiffusion(KernelType kernelType);
+    
 private:
     int rLevels; // Number of levels for red channel
     int gLevels; // Number of levels for green channel
@@ -135,14 +197,67 @@ private:
     // Apply dithering to a color image
     QImage applyToColor(const QImage &image);
     
+    // Quantize the first channels colour channels (1 = gray) with error diffusion
+    QImage diffuse(const QImage &image, int channels);
+    
+    // Quantize with a threshold matrix (ordered dithering)
+    QImage applyThreshold(const QImage &image, int channels);
+    
+    // Threshold matrix of a BAYER_* or BLUE_NOISE type: side x side ranks in [0, ranks)
+    static QVector<int> getThresholdMatrix(KernelType kernelType, int &side, int &ranks);
+    
     // Get diffusion kernel based on the selected type
     struct DiffusionCoefficient {
         int x;      // x offset
         int y;      // y offset
-        double weight; // weight for error diffusion
+        int weight; // share of the error, in units of 1/divisor
     };
     
-    QVector<DiffusionCoefficient> getDiffusionKernel();
+    // divisor receives the common denominator of the weights
+    QVector<DiffusionCoefficient> getDiffusionKernel(int &divisor);
+};
+
+// Hue rotation filter. The HSV filters mix channels, so they are not point
+// operations; each runs as one fused pass through HsvImage::adjust().
+class HueRotationFilter : public FunctionFilter
+{
+public:
+    HueRotationFilter(double degrees = 0.0);
+    QImage apply(const QImage &image) override;
+    void setDegrees(double degrees);
+    double getDegrees() const;
+    
+private:
+    double degrees; // Any sign, wraps around the circle
+};
+
+// Saturation gain filter
+class SaturationFilter : public FunctionFilter
+{
+public:
+    SaturationFilter(double gain = 1.0);
+    QImage apply(const QImage &image) override;
+    void setGain(double gain);
+    double getGain() const;
+    
+private:
+    double gain; // Range: 0.0 (gray) upwards; saturation is clamped to 1
+};
+
+// Value gain and gamma filter: V' = 255 * gain * (V / 255)^(1 / gamma)
+class ValueFilter : public FunctionFilter
+{
+public:
+    ValueFilter(double gain = 1.0, double gamma = 1.0);
+    QImage apply(const QImage &image) override;
+    void setGain(double gain);
+    double getGain() const;
+    void setGamma(double gamma);
+    double getGamma() const;
+    
+private:
+    double gain;  // Range: 0.0 upwards
+    double gamma; // Range: 0.1 to 10.0
 };
 
 #endif // FUNCTIONFILTERS_H 
\ No newline at end of file
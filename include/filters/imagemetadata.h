@@ -0,0 +1,36 @@
+#ifndef IMAGEMETADATA_H
+#define IMAGEMETADATA_H
+
+#include <QImage>
+
+// Colour facts about an image that filters would otherwise rescan for.
+// They are stored as QImage text, so they travel with copies of the image.
+class ImageMetadata
+{
+public:
+    // Text key of the grayscale flag
+    static const char *const GrayscaleKey;
+    
+    // True if every pixel has R == G == B. Trusts the flag and gray formats,
+    // and otherwise scans until the first row with a colour pixel.
+    static bool isGrayscale(const QImage &image);
+    
+    // Flag (or stop flagging) the image as known to be gray. Only the
+    // positive fact is stored; no flag means unknown.
+    static void setGrayscale(QImage &image, bool grayscale);
+    static bool isMarkedGrayscale(const QImage &image);
+    
+    // Carry the flag from a filter input to an output that stays gray
+    static void copyGrayscale(const QImage &from, QImage &to);
+    
+    // Prepare a freshly decoded image for the filters: a flag read from the
+    // file is dropped, opaque gray palettes become single-channel, and images
+    // known to be gray get the flag
+    static void prepareLoaded(QImage &image);
+    
+    // The image to hand to QImageWriter. Writers save QImage text (as PNG
+    // tEXt chunks, for one), so an image carrying the flag is copied without it.
+    static QImage forWriting(const QImage &image);
+};
+
+#endif // IMAGEMETADATA_H
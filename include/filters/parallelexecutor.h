@@ -0,0 +1,28 @@
+#ifndef PARALLELEXECUTOR_H
+#define PARALLELEXECUTOR_H
+
+#include <functional>
+
+// Splits row-wise filter work across a private thread pool.
+// The calling thread takes part, and work items are claimed in increasing
+// order, so an item never waits on one that has not started yet. Every item
+// writes its own rows, which keeps the output identical to a serial run.
+// Under a FilterJob, items count towards its progress and a cancelled job
+// skips the items that have not started.
+class ParallelExecutor
+{
+public:
+    // Threads used per call, the calling thread included.
+    // 0 selects QThread::idealThreadCount(); the IMAGEFILTERING_THREADS
+    // environment variable sets the initial value.
+    static void setWorkerCount(int count);
+    static int workerCount();
+    
+    // Call task(index) for every index in [0, count)
+    static void forEach(int count, const std::function<void(int)> &task);
+    
+    // Call task(firstRow, endRow) for consecutive row bands covering [0, height)
+    static void forEachRowBand(int height, const std::function<void(int, int)> &task);
+};
+
+#endif // PARALLELEXECUTOR_H
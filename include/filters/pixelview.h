@@ -0,0 +1,121 @@
+#ifndef PIXELVIEW_H
+#define PIXELVIEW_H
+
+#include <QImage>
+
+// Row-pointer access to image data in the internal 32-bit layout (0xAARRGGBB).
+// Filters read and write through these views instead of QImage::pixel()/setPixel(),
+// which pay a bounds check, a format switch and a detach check for every pixel.
+
+// Read-only view over an image normalized to the internal layout
+class ConstPixelView
+{
+public:
+    explicit ConstPixelView(const QImage &image);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    const QImage &image() const { return source; }
+
+    const QRgb *row(int y) const {
+        return reinterpret_cast<const QRgb *>(bits + y * stride);
+    }
+
+    QRgb pixel(int x, int y) const {
+        return row(y)[x];
+    }
+
+private:
+    QImage source;
+    const uchar *bits;
+    qsizetype stride;
+    int w;
+    int h;
+};
+
+// Writable view over an image that is already in the internal layout
+class PixelView
+{
+public:
+    explicit PixelView(QImage &image);
+
+    int width() const { return w; }
+    int height() const { return h; }
+
+    QRgb *row(int y) const {
+        return reinterpret_cast<QRgb *>(bits + y * stride);
+    }
+
+    // Internal format for an image: RGB32 when there is no alpha channel, ARGB32 otherwise
+    static QImage::Format internalFormat(const QImage &image);
+
+    // Convert an image to the internal layout (no copy if it already is)
+    static QImage normalize(const QImage &image);
+
+    // Allocate an uninitialized image with the size, format and metadata of a source view
+    static QImage createResult(const ConstPixelView &source);
+
+private:
+    uchar *bits;
+    qsizetype stride;
+    int w;
+    int h;
+};
+
+// Read-only view over an image normalized to one 8-bit channel per pixel
+// (Format_Grayscale8). Images known to be gray keep this layout, so filters
+// process one channel instead of three identical ones.
+class ConstGrayView
+{
+public:
+    explicit ConstGrayView(const QImage &image);
+
+    int width() const { return w; }
+    int height() const { return h; }
+    const QImage &image() const { return source; }
+
+    const uchar *row(int y) const {
+        return bits + y * stride;
+    }
+
+private:
+    QImage source;
+    const uchar *bits;
+    qsizetype stride;
+    int w;
+    int h;
+};
+
+// Writable view over a Format_Grayscale8 image
+class GrayView
+{
+public:
+    explicit GrayView(QImage &image);
+
+    int width() const { return w; }
+    int height() const { return h; }
+
+    uchar *row(int y) const {
+        return bits + y * stride;
+    }
+
+    // True for the single-channel formats filters keep single-channel.
+    // 16-bit gray is reduced to 8 bits, the depth every filter works at.
+    static bool isGrayFormat(const QImage &image);
+
+    // Convert an image to Format_Grayscale8 (no copy if it already is)
+    static QImage normalize(const QImage &image);
+
+    // Allocate an uninitialized gray image with the size and metadata of a
+    // source view; from a 32-bit view when a filter turns it gray
+    static QImage createResult(const ConstGrayView &source);
+    static QImage createResult(const ConstPixelView &source);
+
+private:
+    uchar *bits;
+    qsizetype stride;
+    int w;
+    int h;
+};
+
+#endif // PIXELVIEW_H
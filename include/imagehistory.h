@@ -0,0 +1,96 @@
+#ifndef IMAGEHISTORY_H
+#define IMAGEHISTORY_H
+
+#include <QImage>
+#include <QByteArray>
+#include <QColorSpace>
+#include <QPoint>
+#include <QVector>
+#include <QMap>
+#include <QString>
+#include <QTemporaryFile>
+
+// Undo stack of images held within a memory budget. The newest entry stays a
+// plain image, so undoing one step is free. Past the budget, the oldest plain
+// entries are compressed losslessly as their XOR difference to the next newer
+// entry, and if that is not enough the oldest compressed ones move to a
+// temporary file. Older steps are rebuilt from the newer one as they are
+// undone.
+class ImageHistory
+{
+public:
+    // Budget in bytes; 0 selects the default of IMAGEFILTERING_HISTORY_MB
+    // megabytes from the environment, or 1 GB
+    explicit ImageHistory(qint64 budget = 0);
+    
+    void setBudget(qint64 bytes);
+    qint64 getBudget() const;
+    
+    void push(const QImage &image);
+    
+    // Remove and return the newest entry. A null image means it could not be
+    // read back; the history is then cleared.
+    QImage pop();
+    
+    bool isEmpty() const;
+    int size() const;
+    void clear();
+    
+    // Bytes the entries hold in memory
+    qint64 memoryUsage() const;
+
+private:
+    enum Storage {
+        PLAIN,      // The image itself
+        COMPRESSED, // Compressed pixel rows
+        DELTA       // Compressed XOR of the pixel rows with the next newer entry
+    };
+    
+    struct Entry
+    {
+        Storage storage;
+        QImage image; // PLAIN only
+        
+        // Layout and metadata of COMPRESSED and DELTA entries
+        int width;
+        int height;
+        QImage::Format format;
+        QVector<QRgb> colorTable;
+        QMap<QString, QString> text;
+        int dotsPerMeterX;
+        int dotsPerMeterY;
+        QPoint offset;
+        QColorSpace colorSpace;
+        int rowsPerChunk;
+        
+        // Compressed row chunks, or their place in the spill file
+        QVector<QByteArray> chunks;
+        QVector<qint64> spillOffsets;
+        QVector<qint64> spillSizes;
+    };
+    
+    QVector<Entry> entries; // Oldest first
+    QImage base;            // Last image popped, which a DELTA on top refers to
+    qint64 budget;
+    QTemporaryFile spillFile;
+    
+    void enforceBudget();
+    static qint64 entryBytes(const Entry &entry);
+    
+    // Compress entries[index], as a DELTA if the next newer entry is plain
+    // and has the same layout
+    void compress(int index);
+    
+    // Move the chunks of a compressed entry to the spill file
+    bool spill(Entry &entry);
+    
+    // Shrink the spill file to the chunks of the remaining entries. Entries
+    // spill oldest first, so those chunks are always at its start.
+    void truncateSpill();
+    
+    // Rebuild the image of a compressed entry; newer is the image of the
+    // next newer entry, used by DELTA
+    QImage restore(const Entry &entry, const QImage &newer);
+};
+
+#endif // IMAGEHISTORY_H
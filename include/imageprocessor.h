@@ -7,6 +7,9 @@
 #include <QMap>
 #include <functional>
 #include "filters/functionfilters.h" // Include to access DitheringFilter::KernelType
+#include "filters/hsvimage.h"
+#include "filters/borderextension.h"
+#include "filters/filtergraph.h"
 
 // Forward declarations
 class FunctionFilter;
@@ -27,6 +30,15 @@ public:
     QImage applyUniformQuantization(const QImage &image, int rLevels, int gLevels, int bLevels);
     QImage applyDithering(const QImage &image, int rLevels, int gLevels, int bLevels, DitheringFilter::KernelType kernelType);
     
+    // HSV adjustments, each in one pass without building an HsvImage
+    QImage applyHueRotation(const QImage &image, double degrees);
+    QImage applySaturation(const QImage &image, double gain);
+    QImage applyValueAdjustment(const QImage &image, double gain, double gamma = 1.0);
+    
+    // Apply filters in order, fusing each run of consecutive point filters
+    // (inversion, brightness, contrast, gamma, uniform quantization) into one pass
+    QImage applyPointFilterChain(const QImage &image, const QVector<FunctionFilter *> &filters);
+    
     // Get dithering kernel names
     QStringList getDitheringKernelNames() const;
 
@@ -36,7 +48,8 @@ public:
                                  double divisor = 1.0,
                                  double offset = 0.0,
                                  int anchorX = -1,
-                                 int anchorY = -1);
+                                 int anchorY = -1,
+                                 BorderExtension::Mode boundary = BorderExtension::MIRROR);
 
     // Predefined convolution filters
     QImage applyBlur(const QImage &image);
@@ -46,7 +59,8 @@ public:
     QImage applyEmboss(const QImage &image);
     
     // Median filter
-    QImage applyMedianFilter(const QImage &image, int size = 3);
+    QImage applyMedianFilter(const QImage &image, int size = 3,
+                             BorderExtension::Mode boundary = BorderExtension::MIRROR);
 
     // Get predefined kernels
     QVector<QVector<double>> getBlurKernel() const;
@@ -70,23 +84,22 @@ public:
                          double &offset);
     QStringList getCustomFilterNames() const;
 
-    // HSV conversion methods
-    QImage convertToHSV(const QImage &image);
-    QImage convertToRGB(const QImage &hsvImage);
-    QImage getHueChannel(const QImage &hsvImage);
-    QImage getSaturationChannel(const QImage &hsvImage);
-    QImage getValueChannel(const QImage &hsvImage);
+    // Save and load filter graphs, kept as JSON beside the custom filters
+    bool saveFilterGraph(const QString &name, const FilterGraph &graph);
+    bool loadFilterGraph(const QString &name, FilterGraph &graph, QString &error);
+    QStringList getFilterGraphNames() const;
+
+    // HSV conversion methods. The channel getters return Format_Grayscale8
+    // views of the planes without copying them.
+    HsvImage convertToHSV(const QImage &image);
+    QImage convertToRGB(const HsvImage &hsvImage);
+    QImage getHueChannel(const HsvImage &hsvImage);
+    QImage getSaturationChannel(const HsvImage &hsvImage);
+    QImage getValueChannel(const HsvImage &hsvImage);
 
 private:
     // Helper methods
     QRgb applyFunctionToPixel(QRgb pixel, std::function<int(int)> func);
-    QRgb applyConvolutionToPixel(const QImage &image, int x, int y, 
-                                const QVector<QVector<double>> &kernel,
-                                double divisor, double offset,
-                                int anchorX, int anchorY);
-    
-    // Boundary handling for convolution
-    QRgb getPixelWithBoundary(const QImage &image, int x, int y);
     
     // Storage for custom filters
     QMap<QString, QVector<QVector<double>>> customKernels;
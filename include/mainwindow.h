@@ -22,9 +22,17 @@
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
-#include <QStack>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QProgressBar>
+#include <functional>
+#include <memory>
 
 #include "imageprocessor.h"
+#include "imagehistory.h"
+#include "filters/filterjob.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -43,11 +51,15 @@ private slots:
     void saveImage();
     void resetImage();
     void applyFilter();
+    void applyFilterGraph();
+    void cancelFilter();
     void undoFilter();
     void updateKernelSize();
     void updateKernelTable();
     void calculateDivisor();
     void updateFilterPreview();
+    void schedulePreview();
+    void renderPreview();
     void loadPredefinedFilter(int index);
 
 private:
@@ -56,7 +68,7 @@ private:
     // Image display
     QImage originalImage;
     QImage currentImage;
-    QStack<QImage> imageHistory;
+    ImageHistory imageHistory;
     QLabel *imageLabel;
     QScrollArea *scrollArea;
     QLabel *originalImageLabel;
@@ -71,6 +83,9 @@ private:
     QDoubleSpinBox *brightnessSpinBox;
     QDoubleSpinBox *contrastSpinBox;
     QDoubleSpinBox *gammaSpinBox;
+    QDoubleSpinBox *hueSpinBox;
+    QDoubleSpinBox *saturationSpinBox;
+    QDoubleSpinBox *valueSpinBox;
     
     // Uniform quantization parameters
     QGroupBox *quantizationParamsGroup;
@@ -102,6 +117,7 @@ private:
     
     // Buttons
     QPushButton *applyButton;
+    QPushButton *cancelButton;
     QPushButton *undoButton;
     QPushButton *resetButton;
     QPushButton *saveButton;
@@ -111,6 +127,21 @@ private:
     // Image processor
     ImageProcessor processor;
     
+    // Filter running on a worker thread, if any
+    QThread *filterThread;
+    std::shared_ptr<FilterJob> filterJob;
+    QProgressBar *progressBar;
+    
+    // Live preview of the selected filter on the visible part of the image.
+    // Every settings change bumps the generation; renders of an older one
+    // are cancelled or dropped.
+    QCheckBox *livePreviewCheckBox;
+    QLabel *previewLabel;
+    QTimer *previewTimer;
+    QThreadPool previewPool;
+    QAtomicInt previewGeneration;
+    std::shared_ptr<FilterJob> previewJob;
+    
     // Layouts
     QHBoxLayout *mainLayout;
     
@@ -133,6 +164,14 @@ private:
     void displayImage(const QImage &image);
     void displayOriginalImage(const QImage &image);
     void enableFilterControls(bool enable);
+    void startFilterJob(const QString &name, const std::function<QImage(const QImage &)> &filter);
+    void finishFilterJob(const QString &name, bool cancelled, const QImage &result);
+    void setFilterRunning(bool running);
+    std::function<QImage(const QImage &)> selectedFilter(int &margin);
+    void showPreview(int generation, const QRect &area, const QImage &image);
+    void clearPreview();
+    QPoint imageOrigin() const;
+    QRect visibleImageRect() const;
     void setupFunctionFilterControls();
     void setupConvolutionFilterControls();
     void setupMedianFilterControls();
@@ -0,0 +1,238 @@
+#include "batchpipeline.h"
+#include "filters/imagemetadata.h"
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+namespace {
+
+struct Item
+{
+    QString input;
+    QString output;
+    QImage image;
+};
+
+// FIFO between two stages. push() waits while the queue is full and pop()
+// while it is empty; pop() returns false once it is closed and drained.
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)
+        : capacity(capacity), closed(false)
+    {
+    }
+    
+    void push(const Item &item) {
+        QMutexLocker locker(&mutex);
+        while (items.size() >= capacity) {
+            notFull.wait(&mutex);
+        }
+        items.enqueue(item);
+        notEmpty.wakeOne();
+    }
+    
+    bool pop(Item &item) {
+        QMutexLocker locker(&mutex);
+        while (items.isEmpty() && !closed) {
+            notEmpty.wait(&mutex);
+        }
+        if (items.isEmpty()) {
+            return false;
+        }
+        item = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+    
+    // No more pushes; wakes the consumers so they drain and stop
+    void close() {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        notEmpty.wakeAll();
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
+    QQueue<Item> items;
+    int capacity;
+    bool closed;
+};
+
+bool decode(Item &item, QString &error)
+{
+    QImageReader reader(item.input);
+    reader.setAutoTransform(true);
+    item.image = reader.read();
+    if (item.image.isNull()) {
+        error = QString("%1: %2").arg(item.input, reader.errorString());
+        return false;
+    }
+    ImageMetadata::prepareLoaded(item.image);
+    return true;
+}
+
+// Key comparing paths the way the file system does
+QString pathKey(const QString &path)
+{
+    QString absolute = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    return absolute.toLower();
+#else
+    return absolute;
+#endif
+}
+
+} // namespace
+
+BatchPipeline::BatchPipeline()
+    : workers { 1, 2, 1 }, queueCapacity(2)
+{
+}
+
+void BatchPipeline::setFilters(const QVector<FilterStep> &chain) {
+    graph = FilterGraph::fromSteps(chain);
+}
+
+void BatchPipeline::setGraph(const FilterGraph &graph) {
+    this->graph = graph;
+}
+
+void BatchPipeline::setOutput(const QDir &directory, const QString &format) {
+    outputDir = directory;
+    this->format = format;
+}
+
+void BatchPipeline::setWorkerCount(Stage stage, int count) {
+    workers[stage] = qMax(1, count);
+}
+
+int BatchPipeline::workerCount(Stage stage) const {
+    return workers[stage];
+}
+
+void BatchPipeline::setQueueCapacity(int images) {
+    queueCapacity = qMax(1, images);
+}
+
+int BatchPipeline::getQueueCapacity() const {
+    return queueCapacity;
+}
+
+int BatchPipeline::maxImagesInFlight() const {
+    return workers[DECODE] + workers[FILTER] + workers[ENCODE] + 2 * queueCapacity;
+}
+
+QString BatchPipeline::outputPath(const QString &input) const {
+    QFileInfo info(input);
+    QString suffix = format.isEmpty() ? info.suffix() : format;
+    return outputDir.filePath(info.completeBaseName() + "." + suffix);
+}
+
+int BatchPipeline::run(const QStringList &inputs, QStringList &errors) {
+    // Inputs whose result would replace an input file, or the result of an
+    // earlier input, fail up front rather than overwrite it
+    QHash<QString, QString> sources;
+    for (const QString &input : inputs) {
+        sources.insert(pathKey(input), input);
+    }
+    
+    QVector<Item> items;
+    QHash<QString, QString> writers;
+    for (const QString &input : inputs) {
+        Item item;
+        item.input = input;
+        item.output = outputPath(input);
+        QString key = pathKey(item.output);
+        if (sources.contains(key)) {
+            errors.append(QString("%1: output file %2 would overwrite input %3").arg(input, item.output, sources.value(key)));
+        } else if (writers.contains(key)) {
+            errors.append(QString("%1: same output file %2 as %3").arg(input, item.output, writers.value(key)));
+        } else {
+            writers.insert(key, input);
+            items.append(item);
+        }
+    }
+    
+    BoundedQueue decoded(queueCapacity);
+    BoundedQueue filtered(queueCapacity);
+    
+    QAtomicInt nextInput(0);
+    QAtomicInt written(0);
+    
+    // The last worker of a stage to finish closes the queue it feeds
+    QAtomicInt decoders(workers[DECODE]);
+    QAtomicInt filterers(workers[FILTER]);
+    
+    QMutex errorMutex;
+    auto fail = [&](const QString &message) {
+        QMutexLocker locker(&errorMutex);
+        errors.append(message);
+    };
+    
+    // Every worker needs its own thread, or a stage could wait on one that never starts
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers[DECODE] + workers[FILTER] + workers[ENCODE]);
+    
+    for (int i = 0; i < workers[DECODE]; ++i) {
+        pool.start([&]() {
+            for (int index = nextInput.fetchAndAddRelaxed(1); index < items.size();
+                 index = nextInput.fetchAndAddRelaxed(1)) {
+                Item item = items[index];
+                QString error;
+                if (decode(item, error)) {
+                    decoded.push(item);
+                } else {
+                    fail(error);
+                }
+            }
+            if (decoders.fetchAndAddOrdered(-1) == 1) {
+                decoded.close();
+            }
+        });
+    }
+    
+    for (int i = 0; i < workers[FILTER]; ++i) {
+        pool.start([&]() {
+            Item item;
+            while (decoded.pop(item)) {
+                item.image = graph.apply(item.image);
+                if (item.image.isNull()) {
+                    fail(QString("%1: filtering failed").arg(item.input));
+                } else {
+                    filtered.push(item);
+                }
+                item = Item();
+            }
+            if (filterers.fetchAndAddOrdered(-1) == 1) {
+                filtered.close();
+            }
+        });
+    }
+    
+    for (int i = 0; i < workers[ENCODE]; ++i) {
+        pool.start([&]() {
+            Item item;
+            while (filtered.pop(item)) {
+                QImageWriter writer(item.output);
+                if (writer.write(ImageMetadata::forWriting(item.image))) {
+                    written.fetchAndAddRelaxed(1);
+                } else {
+                    fail(QString("%1: %2").arg(item.output, writer.errorString()));
+                }
+                item = Item();
+            }
+        });
+    }
+    
+    pool.waitForDone();
+    return written.loadRelaxed();
+}
@@ -0,0 +1,73 @@
+#include "filters/borderextension.h"
+#include <algorithm>
+#include <cstring>
+
+// Padded columns [0, length) of a row; the part inside the image is one copy
+template <typename Pixel>
+static void extendPixels(const BorderExtension &border, const Pixel *row, int width, int left,
+                         int length, Pixel constant, Pixel *out) {
+    int begin = qBound(0, left, length);
+    int end = qBound(begin, left + width, length);
+    
+    for (int p = 0; p < begin; ++p) {
+        int x = border.sourceIndex(p - left, width);
+        out[p] = x >= 0 ? row[x] : constant;
+    }
+    std::memcpy(out + begin, row + (begin - left), static_cast<size_t>(end - begin) * sizeof(Pixel));
+    for (int p = end; p < length; ++p) {
+        int x = border.sourceIndex(p - left, width);
+        out[p] = x >= 0 ? row[x] : constant;
+    }
+}
+
+BorderExtension::BorderExtension(Mode mode, QRgb color) : mode(mode), color(color) {}
+
+BorderExtension::Mode BorderExtension::getMode() const {
+    return mode;
+}
+
+QRgb BorderExtension::getColor() const {
+    return color;
+}
+
+bool BorderExtension::isGray() const {
+    return mode != CONSTANT || (qRed(color) == qGreen(color) && qGreen(color) == qBlue(color));
+}
+
+int BorderExtension::sourceIndex(int i, int size) const {
+    if (i >= 0 && i < size) {
+        return i;
+    }
+    
+    switch (mode) {
+        case CLAMP:
+            return qBound(0, i, size - 1);
+        case WRAP:
+            return (i % size + size) % size;
+        case CONSTANT:
+            return -1;
+        default: {
+            // Reflections repeat with this period; the right edge pixel is
+            // read twice and the left one once
+            int period = 2 * size - 1;
+            int folded = (i % period + period) % period;
+            return folded < size ? folded : period - folded;
+        }
+    }
+}
+
+void BorderExtension::extendRow(const QRgb *row, int width, int left, int length, QRgb *out) const {
+    extendPixels(*this, row, width, left, length, color, out);
+}
+
+void BorderExtension::extendRow(const uchar *row, int width, int left, int length, uchar *out) const {
+    extendPixels(*this, row, width, left, length, static_cast<uchar>(qGray(color)), out);
+}
+
+void BorderExtension::fillConstant(QRgb *out, int length) const {
+    std::fill(out, out + length, color);
+}
+
+void BorderExtension::fillConstant(uchar *out, int length) const {
+    std::fill(out, out + length, static_cast<uchar>(qGray(color)));
+}
@@ -0,0 +1,314 @@
+#include "filters/convolutionbackend.h"
+#include <QAtomicInt>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGEFILTERING_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef void (*AccumulateFunction)(float *, const float *, float, int);
+typedef void (*PackFunction)(const float *, const float *, const float *,
+                             const QRgb *, QRgb *, int, double, double);
+
+// Scalar backend, also used for double sums on every backend
+template <typename T>
+void accumulateScalar(T *acc, const T *src, T weight, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        T product = src[i] * weight;
+        acc[i] += product;
+    }
+}
+
+template <typename T>
+int packChannel(T sum, double divisor, double offset)
+{
+    return qBound(0, static_cast<int>(sum / divisor + offset), 255);
+}
+
+template <typename T>
+void packScalar(const T *red, const T *green, const T *blue,
+                const QRgb *alphaSource, QRgb *out, int count,
+                double divisor, double offset)
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = qRgba(packChannel(red[i], divisor, offset),
+                       packChannel(green[i], divisor, offset),
+                       packChannel(blue[i], divisor, offset),
+                       qAlpha(alphaSource[i]));
+    }
+}
+
+template <typename T>
+void packGrayScalar(const T *sums, uchar *out, int count, double divisor, double offset)
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = static_cast<uchar>(packChannel(sums[i], divisor, offset));
+    }
+}
+
+#ifdef IMAGEFILTERING_X86_SIMD
+
+// Clamp four truncated channel values to 0..255 the way qBound does:
+// out-of-range conversions yield INT_MIN, which saturates to 0
+__attribute__((target("sse2")))
+__m128i saturateChannel(__m128i values)
+{
+    __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(values, values), _mm_setzero_si128());
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, _mm_setzero_si128()), _mm_setzero_si128());
+}
+
+__attribute__((target("sse2")))
+__m128i combinePixels(__m128i r, __m128i g, __m128i b, const QRgb *alphaSource)
+{
+    __m128i alpha = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(alphaSource)),
+                                  _mm_set1_epi32(static_cast<int>(0xff000000)));
+    __m128i rgb = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(saturateChannel(r), 16),
+                                            _mm_slli_epi32(saturateChannel(g), 8)),
+                               saturateChannel(b));
+    return _mm_or_si128(alpha, rgb);
+}
+
+// SSE2 backend
+__attribute__((target("sse2")))
+void accumulateSSE2(float *acc, const float *src, float weight, int count)
+{
+    __m128 w = _mm_set1_ps(weight);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(src + i), w);
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), product));
+    }
+    accumulateScalar(acc + i, src + i, weight, count - i);
+}
+
+__attribute__((target("sse2")))
+__m128i convertSSE2(const float *sums, __m128d divisor, __m128d offset)
+{
+    __m128 values = _mm_loadu_ps(sums);
+    __m128d low = _mm_add_pd(_mm_div_pd(_mm_cvtps_pd(values), divisor), offset);
+    __m128d high = _mm_add_pd(_mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(values, values)), divisor), offset);
+    return _mm_unpacklo_epi64(_mm_cvttpd_epi32(low), _mm_cvttpd_epi32(high));
+}
+
+__attribute__((target("sse2")))
+void packSSE2(const float *red, const float *green, const float *blue,
+              const QRgb *alphaSource, QRgb *out, int count,
+              double divisor, double offset)
+{
+    __m128d d = _mm_set1_pd(divisor);
+    __m128d o = _mm_set1_pd(offset);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = combinePixels(convertSSE2(red + i, d, o),
+                                       convertSSE2(green + i, d, o),
+                                       convertSSE2(blue + i, d, o),
+                                       alphaSource + i);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), pixels);
+    }
+    packScalar(red + i, green + i, blue + i, alphaSource + i, out + i, count - i, divisor, offset);
+}
+
+// Store four clamped channel values as bytes
+__attribute__((target("sse2")))
+void storeGray(__m128i values, uchar *out)
+{
+    int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(values, values), _mm_setzero_si128()));
+    std::memcpy(out, &bytes, 4);
+}
+
+__attribute__((target("sse2")))
+void packGraySSE2(const float *sums, uchar *out, int count, double divisor, double offset)
+{
+    __m128d d = _mm_set1_pd(divisor);
+    __m128d o = _mm_set1_pd(offset);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        storeGray(convertSSE2(sums + i, d, o), out + i);
+    }
+    packGrayScalar(sums + i, out + i, count - i, divisor, offset);
+}
+
+// AVX2 backend
+__attribute__((target("avx2")))
+void accumulateAVX2(float *acc, const float *src, float weight, int count)
+{
+    __m256 w = _mm256_set1_ps(weight);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 product = _mm256_mul_ps(_mm256_loadu_ps(src + i), w);
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), product));
+    }
+    accumulateScalar(acc + i, src + i, weight, count - i);
+}
+
+__attribute__((target("avx2")))
+__m128i convertAVX2(const float *sums, __m256d divisor, __m256d offset)
+{
+    __m256d values = _mm256_cvtps_pd(_mm_loadu_ps(sums));
+    return _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_div_pd(values, divisor), offset));
+}
+
+__attribute__((target("avx2")))
+void packAVX2(const float *red, const float *green, const float *blue,
+              const QRgb *alphaSource, QRgb *out, int count,
+              double divisor, double offset)
+{
+    __m256d d = _mm256_set1_pd(divisor);
+    __m256d o = _mm256_set1_pd(offset);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = combinePixels(convertAVX2(red + i, d, o),
+                                       convertAVX2(green + i, d, o),
+                                       convertAVX2(blue + i, d, o),
+                                       alphaSource + i);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), pixels);
+    }
+    packScalar(red + i, green + i, blue + i, alphaSource + i, out + i, count - i, divisor, offset);
+}
+
+__attribute__((target("avx2")))
+void packGrayAVX2(const float *sums, uchar *out, int count, double divisor, double offset)
+{
+    __m256d d = _mm256_set1_pd(divisor);
+    __m256d o = _mm256_set1_pd(offset);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        storeGray(convertAVX2(sums + i, d, o), out + i);
+    }
+    packGrayScalar(sums + i, out + i, count - i, divisor, offset);
+}
+
+#endif // IMAGEFILTERING_X86_SIMD
+
+ConvolutionBackend::Type initialForced()
+{
+    QByteArray value = qgetenv("IMAGEFILTERING_SIMD").toLower();
+    if (value == "scalar") return ConvolutionBackend::SCALAR;
+    if (value == "sse2") return ConvolutionBackend::SSE2;
+    if (value == "avx2") return ConvolutionBackend::AVX2;
+    return ConvolutionBackend::AUTO;
+}
+
+ConvolutionBackend::Type resolve(ConvolutionBackend::Type requested)
+{
+    if (requested == ConvolutionBackend::AUTO) {
+        requested = ConvolutionBackend::AVX2;
+    }
+    while (!ConvolutionBackend::isSupported(requested)) {
+        requested = static_cast<ConvolutionBackend::Type>(requested - 1);
+    }
+    return requested;
+}
+
+QAtomicInt forcedType(initialForced());
+QAtomicInt activeType(resolve(static_cast<ConvolutionBackend::Type>(forcedType.loadRelaxed())));
+
+} // namespace
+
+void ConvolutionBackend::setForced(Type type) {
+    forcedType.storeRelaxed(type);
+    activeType.storeRelaxed(resolve(type));
+}
+
+ConvolutionBackend::Type ConvolutionBackend::forced() {
+    return static_cast<Type>(forcedType.loadRelaxed());
+}
+
+ConvolutionBackend::Type ConvolutionBackend::active() {
+    return static_cast<Type>(activeType.loadRelaxed());
+}
+
+bool ConvolutionBackend::isSupported(Type type) {
+    switch (type) {
+        case SCALAR:
+            return true;
+#ifdef IMAGEFILTERING_X86_SIMD
+        case SSE2:
+            return __builtin_cpu_supports("sse2");
+        case AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+QString ConvolutionBackend::getName(Type type) {
+    switch (type) {
+        case AUTO: return "auto";
+        case SCALAR: return "scalar";
+        case SSE2: return "sse2";
+        case AVX2: return "avx2";
+    }
+    return QString();
+}
+
+void ConvolutionBackend::accumulate(float *acc, const float *src, float weight, int count) {
+    switch (active()) {
+#ifdef IMAGEFILTERING_X86_SIMD
+        case AVX2:
+            accumulateAVX2(acc, src, weight, count);
+            return;
+        case SSE2:
+            accumulateSSE2(acc, src, weight, count);
+            return;
+#endif
+        default:
+            accumulateScalar(acc, src, weight, count);
+            return;
+    }
+}
+
+void ConvolutionBackend::pack(const float *red, const float *green, const float *blue,
+                              const QRgb *alphaSource, QRgb *out, int count,
+                              double divisor, double offset) {
+    switch (active()) {
+#ifdef IMAGEFILTERING_X86_SIMD
+        case AVX2:
+            packAVX2(red, green, blue, alphaSource, out, count, divisor, offset);
+            return;
+        case SSE2:
+            packSSE2(red, green, blue, alphaSource, out, count, divisor, offset);
+            return;
+#endif
+        default:
+            packScalar(red, green, blue, alphaSource, out, count, divisor, offset);
+            return;
+    }
+}
+
+void ConvolutionBackend::packGray(const float *sums, uchar *out, int count,
+                                  double divisor, double offset) {
+    switch (active()) {
+#ifdef IMAGEFILTERING_X86_SIMD
+        case AVX2:
+            packGrayAVX2(sums, out, count, divisor, offset);
+            return;
+        case SSE2:
+            packGraySSE2(sums, out, count, divisor, offset);
+            return;
+#endif
+        default:
+            packGrayScalar(sums, out, count, divisor, offset);
+            return;
+    }
+}
+
+void ConvolutionBackend::accumulate(double *acc, const double *src, double weight, int count) {
+    accumulateScalar(acc, src, weight, count);
+}
+
+void ConvolutionBackend::pack(const double *red, const double *green, const double *blue,
+                              const QRgb *alphaSource, QRgb *out, int count,
+                              double divisor, double offset) {
+    packScalar(red, green, blue, alphaSource, out, count, divisor, offset);
+}
+
+void ConvolutionBackend::packGray(const double *sums, uchar *out, int count,
+                                  double divisor, double offset) {
+    packGrayScalar(sums, out, count, divisor, offset);
+}
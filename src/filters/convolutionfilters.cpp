@@ -1,19 +1,571 @@
 #include "filters/convolutionfilters.h"
+#include "filters/pixelview.h"
+#include "filters/imagemetadata.h"
+#include "filters/parallelexecutor.h"
+#include "filters/filterjob.h"
+#include "filters/convolutionbackend.h"
+#include "filters/fouriertransform.h"
 #include <QColor>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <cmath>
 #include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Relative error allowed when matching a kernel to its rank-1 factorization
+static const double SeparableTolerance = 1e-9;
+
+// Pixels per block of the sorting-network median. Lane loops have this
+// fixed trip count, so the compiler turns them into vector min/max.
+static const int MedianLanes = 16;
+
+// Kernels smaller than this never beat the spatial path, so they skip the measurement
+static const int MinimumFrequencyTaps = 49;
+
+// Largest FFT tile chosen for kernels that fit in a smaller one
+static const int MaximumTileSize = 256;
+
+static int initialFrequencyThreshold() {
+    bool ok = false;
+    int taps = qEnvironmentVariableIntValue("IMAGEFILTERING_FFT_THRESHOLD", &ok);
+    return ok ? taps : -1;
+}
+
+static QAtomicInt forcedFrequencyThreshold(initialFrequencyThreshold());
+
+// Float holds every integer below this exactly; larger sums round
+static const double FloatExactLimit = 16777216.0;
+
+// Rows are cached under their position, which may lie outside the image
+static const int NoRow = std::numeric_limits<int>::min();
+
+// True if every coefficient is a (not too large) whole number
+static bool isIntegralKernel(const QVector<QVector<double>> &kernel) {
+    for (const auto &row : kernel) {
+        for (double value : row) {
+            if (value != std::floor(value) || std::abs(value) >= 1e9) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Channel planes a view is filtered in: R, G and B, or gray
+static inline int channelCount(const ConstPixelView &) { return 3; }
+static inline int channelCount(const ConstGrayView &) { return 1; }
+
+static inline void loadChannels(QRgb pixel, int *values) {
+    values[0] = qRed(pixel);
+    values[1] = qGreen(pixel);
+    values[2] = qBlue(pixel);
+}
+
+static inline void loadChannels(uchar pixel, int *values) {
+    values[0] = pixel;
+}
+
+// Pixel type of a view's rows: QRgb or uchar
+template <typename View>
+using PixelOf = std::remove_const_t<std::remove_pointer_t<decltype(std::declval<View>().row(0))>>;
+
+// Source row at position y, which may lie outside the image. Rows the
+// border reads as its colour come from constantRow.
+template <typename View, typename Pixel>
+static const Pixel *rowAt(const View &src, const BorderExtension &border, int y, const Pixel *constantRow) {
+    int sourceY = border.sourceIndex(y, src.height());
+    return sourceY >= 0 ? src.row(sourceY) : constantRow;
+}
+
+// Cache slot of row position y among slots consecutive positions
+static inline int rowSlot(int y, int slots) {
+    return (y % slots + slots) % slots;
+}
+
+// Planar copy of a padded row: plane c holds channel c of in[i] at element
+// c * length + i. Channel values are exact in float.
+template <typename T>
+static void loadPlanes(const QRgb *in, int length, T *planes) {
+    T *red = planes;
+    T *green = planes + length;
+    T *blue = planes + 2 * length;
+    for (int i = 0; i < length; ++i) {
+        QRgb pixel = in[i];
+        red[i] = qRed(pixel);
+        green[i] = qGreen(pixel);
+        blue[i] = qBlue(pixel);
+    }
+}
+
+template <typename T>
+static void loadPlanes(const uchar *in, int length, T *planes) {
+    for (int i = 0; i < length; ++i) {
+        planes[i] = in[i];
+    }
+}
+
+// Planar channel values back into pixels, with the alpha of the source pixels
+static void storePlanes(const uchar *planes, int length, const QRgb *in, QRgb *out, int width) {
+    for (int x = 0; x < width; ++x) {
+        out[x] = qRgba(planes[x], planes[length + x], planes[2 * length + x], qAlpha(in[x]));
+    }
+}
+
+static void storePlanes(const uchar *planes, int, const uchar *, uchar *out, int width) {
+    std::memcpy(out, planes, width);
+}
+
+// Convolution sums (planes of width) to pixels
+template <typename Sum>
+static void packSums(const Sum *sums, int width, const QRgb *in, QRgb *out,
+                     double divisor, double offset) {
+    ConvolutionBackend::pack(sums, sums + width, sums + 2 * width, in, out, width, divisor, offset);
+}
+
+template <typename Sum>
+static void packSums(const Sum *sums, int width, const uchar *, uchar *out,
+                     double divisor, double offset) {
+    ConvolutionBackend::packGray(sums, out, width, divisor, offset);
+}
+
+namespace {
+
+// Histograms of one channel for a median window, after Perreault and Hebert,
+// "Median Filtering in Constant Time". Every source column keeps a histogram
+// of the rows under the window. The window histogram adds and drops whole
+// columns as it slides, and is split into 16 coarse bins that are kept
+// current and 16 x 16 fine bins that are brought up to date only when the
+// median falls into them.
+class MedianHistogram
+{
+public:
+    explicit MedianHistogram(int width)
+        : columnCoarse(static_cast<size_t>(width) * 16), columnFine(static_cast<size_t>(width) * 256) {}
+    
+    void updateColumn(int column, int value, int delta) {
+        columnCoarse[static_cast<size_t>(column) * 16 + (value >> 4)] += delta;
+        columnFine[static_cast<size_t>(column) * 256 + value] += delta;
+    }
+    
+    // Load the window over padded columns [0, span) of a new row
+    void startRow(const int *sourceX, int span) {
+        std::fill(coarse, coarse + 16, 0);
+        for (int p = 0; p < span; ++p) {
+            addCoarse(sourceX[p], 1);
+        }
+        std::fill(lastUpdate, lastUpdate + 16, std::numeric_limits<int>::min() / 2);
+    }
+    
+    // Median of the window over padded columns [x, x + span); x advances by one per call
+    int median(int x, const int *sourceX, int span, int target) {
+        if (x > 0) {
+            addCoarse(sourceX[x + span - 1], 1);
+            addCoarse(sourceX[x - 1], -1);
+        }
+        
+        int below = 0;
+        int bucket = 0;
+        while (below + coarse[bucket] <= target) {
+            below += coarse[bucket];
+            ++bucket;
+        }
+        
+        const int *bins = refreshFine(bucket, x, sourceX, span);
+        int value = 0;
+        while (below + bins[value] <= target) {
+            below += bins[value];
+            ++value;
+        }
+        return bucket * 16 + value;
+    }
+
+private:
+    std::vector<quint16> columnCoarse; // 16 bins per source column
+    std::vector<quint16> columnFine;   // 256 bins per source column
+    int coarse[16];
+    int fine[256];
+    int lastUpdate[16]; // Window position each fine bucket is current for
+    
+    void addCoarse(int column, int sign) {
+        const quint16 *bins = columnCoarse.data() + static_cast<size_t>(column) * 16;
+        for (int i = 0; i < 16; ++i) {
+            coarse[i] += sign * bins[i];
+        }
+    }
+    
+    void addFine(int column, int bucket, int sign) {
+        const quint16 *bins = columnFine.data() + static_cast<size_t>(column) * 256 + bucket * 16;
+        int *target = fine + bucket * 16;
+        for (int i = 0; i < 16; ++i) {
+            target[i] += sign * bins[i];
+        }
+    }
+    
+    const int *refreshFine(int bucket, int x, const int *sourceX, int span) {
+        if (x - lastUpdate[bucket] >= span) {
+            // Too stale to slide: rebuild from the columns under the window
+            std::fill(fine + bucket * 16, fine + bucket * 16 + 16, 0);
+            for (int p = x; p < x + span; ++p) {
+                addFine(sourceX[p], bucket, 1);
+            }
+        } else {
+            for (int p = lastUpdate[bucket] + 1; p <= x; ++p) {
+                addFine(sourceX[p + span - 1], bucket, 1);
+                addFine(sourceX[p - 1], bucket, -1);
+            }
+        }
+        lastUpdate[bucket] = x;
+        return fine + bucket * 16;
+    }
+};
+
+} // namespace
+
+// Compare-exchange of two lane vectors: a gets the minima, b the maxima
+static inline void sortLanes(uchar *a, uchar *b) {
+    uchar low[MedianLanes];
+    uchar high[MedianLanes];
+    for (int i = 0; i < MedianLanes; ++i) {
+        low[i] = qMin(a[i], b[i]);
+        high[i] = qMax(a[i], b[i]);
+    }
+    std::memcpy(a, low, MedianLanes);
+    std::memcpy(b, high, MedianLanes);
+}
+
+static inline void minLanes(uchar *a, const uchar *b) {
+    uchar low[MedianLanes];
+    for (int i = 0; i < MedianLanes; ++i) {
+        low[i] = qMin(a[i], b[i]);
+    }
+    std::memcpy(a, low, MedianLanes);
+}
+
+static inline void maxLanes(const uchar *a, uchar *b) {
+    uchar high[MedianLanes];
+    for (int i = 0; i < MedianLanes; ++i) {
+        high[i] = qMax(a[i], b[i]);
+    }
+    std::memcpy(b, high, MedianLanes);
+}
+
+enum NetworkStep { SORT_PAIR, KEEP_MIN, KEEP_MAX };
+
+struct Comparator
+{
+    uchar a;
+    uchar b;
+    uchar step; // KEEP_MIN and KEEP_MAX only compute the output that is still used
+};
+
+// Selects value 12, the median, of a 5x5 window whose columns are already
+// sorted: value c * 5 + k is the k-th smallest of column c. Generated from
+// rank-row sorts followed by Batcher's odd-even merge sort, pruned to the
+// comparators the median depends on, and checked with the 0-1 principle on
+// every column-sorted 0-1 input.
+static const Comparator Median25Network[] = {
+    { 10, 15, SORT_PAIR }, {  0, 15, SORT_PAIR }, {  0, 10, KEEP_MAX }, {  5, 20, SORT_PAIR },
+    {  5, 15, SORT_PAIR }, {  1,  6, SORT_PAIR }, { 16, 21, SORT_PAIR }, { 11, 21, SORT_PAIR },
+    { 11, 16, SORT_PAIR }, {  1, 16, KEEP_MAX }, {  6, 21, SORT_PAIR }, {  6, 16, SORT_PAIR },
+    {  2,  7, SORT_PAIR }, { 17, 22, SORT_PAIR }, { 12, 17, SORT_PAIR }, {  2, 17, SORT_PAIR },
+    {  2, 12, KEEP_MAX }, {  7, 22, SORT_PAIR }, {  7, 17, SORT_PAIR }, {  7, 12, SORT_PAIR },
+    {  3,  8, SORT_PAIR }, { 18, 23, SORT_PAIR }, { 13, 18, SORT_PAIR }, {  3, 18, SORT_PAIR },
+    {  3, 13, SORT_PAIR }, {  8, 23, KEEP_MIN }, {  8, 13, SORT_PAIR }, { 14, 24, SORT_PAIR },
+    { 14, 19, SORT_PAIR }, {  9, 24, KEEP_MIN }, {  4,  5, KEEP_MAX }, { 14, 15, SORT_PAIR },
+    { 18, 19, KEEP_MIN }, {  5,  7, SORT_PAIR }, {  8, 10, KEEP_MAX }, {  9, 11, SORT_PAIR },
+    { 12, 14, SORT_PAIR }, { 13, 15, KEEP_MIN }, { 16, 18, SORT_PAIR }, { 13, 14, SORT_PAIR },
+    { 21, 22, KEEP_MIN }, { 16, 20, SORT_PAIR }, { 17, 21, KEEP_MIN }, {  3,  5, KEEP_MAX },
+    { 10, 12, SORT_PAIR }, { 11, 13, SORT_PAIR }, { 18, 20, KEEP_MIN }, {  5,  6, KEEP_MAX },
+    { 11, 12, SORT_PAIR }, { 13, 14, KEEP_MIN }, {  6, 10, KEEP_MAX }, {  7, 11, SORT_PAIR },
+    {  7,  9, KEEP_MAX }, { 10, 12, SORT_PAIR }, { 11, 13, SORT_PAIR }, {  9, 10, SORT_PAIR },
+    { 11, 12, SORT_PAIR }, { 17, 18, SORT_PAIR }, {  9, 17, KEEP_MAX }, { 10, 18, KEEP_MIN },
+    { 12, 16, KEEP_MIN }, { 13, 17, KEEP_MIN }, { 10, 12, KEEP_MAX }, { 11, 13, KEEP_MIN },
+    { 11, 12, KEEP_MAX }
+};
+
+// Power-of-two tile size with the least FFT work for the whole image
+static int chooseTileSize(int width, int height, int rows, int cols) {
+    int smallest = qMax(32, FourierTransform::nextPowerOfTwo(2 * qMax(rows, cols)));
+    int best = smallest;
+    double bestCost = std::numeric_limits<double>::max();
+    
+    for (int size = smallest; size <= qMax(smallest, MaximumTileSize); size *= 2) {
+        int tilesX = (width + size - cols) / (size - cols + 1);
+        int tilesY = (height + size - rows) / (size - rows + 1);
+        double cost = static_cast<double>(tilesX) * tilesY * size * size * std::log2(size);
+        if (cost < bestCost) {
+            bestCost = cost;
+            best = size;
+        }
+    }
+    return best;
+}
+
+// Transformed kernel for tiles of fft.getSize(). Tap (ky, kx) goes to
+// (-ky, -kx) so the circular convolution computes the same correlation as
+// the spatial path. The 1 / area of the inverse transform is folded in.
+static std::vector<FourierTransform::Complex> kernelSpectrum(const QVector<QVector<double>> &kernel,
+                                                             const FourierTransform &fft) {
+    int tileSize = fft.getSize();
+    size_t area = static_cast<size_t>(tileSize) * tileSize;
+    std::vector<FourierTransform::Complex> spectrum(area);
+    for (int ky = 0; ky < kernel.size(); ++ky) {
+        for (int kx = 0; kx < kernel[ky].size(); ++kx) {
+            size_t index = static_cast<size_t>((tileSize - ky) % tileSize) * tileSize + (tileSize - kx) % tileSize;
+            spectrum[index] = kernel[ky][kx] / area;
+        }
+    }
+    fft.forward2D(spectrum.data());
+    return spectrum;
+}
+
+// Channel value of an FFT convolution sum. Integer kernels have whole-number
+// sums; rounding removes the FFT error.
+static int packFrequencySum(double sum, bool integral, double divisor, double offset) {
+    if (integral) {
+        sum = std::round(sum);
+    }
+    return qBound(0, static_cast<int>(sum / divisor + offset), 255);
+}
+
+// Coefficients of the predefined filters, fixed at compile time. Taps are
+// row-major; the anchor is the centre.
+namespace {
+
+struct BlurTaps
+{
+    static constexpr int Size = 3;
+    static constexpr int Divisor = 9;
+    static constexpr int Offset = 0;
+    static constexpr int Taps[Size * Size] = {
+        1, 1, 1,
+        1, 1, 1,
+        1, 1, 1
+    };
+};
+
+struct GaussianBlurTaps
+{
+    static constexpr int Size = 3;
+    static constexpr int Divisor = 16;
+    static constexpr int Offset = 0;
+    static constexpr int Taps[Size * Size] = {
+        1, 2, 1,
+        2, 4, 2,
+        1, 2, 1
+    };
+};
+
+struct SharpenTaps
+{
+    static constexpr int Size = 3;
+    static constexpr int Divisor = 1;
+    static constexpr int Offset = 0;
+    static constexpr int Taps[Size * Size] = {
+        0, -1, 0,
+        -1, 5, -1,
+        0, -1, 0
+    };
+};
+
+struct EdgeDetectionTaps
+{
+    static constexpr int Size = 3;
+    static constexpr int Divisor = 1;
+    static constexpr int Offset = 0;
+    static constexpr int Taps[Size * Size] = {
+        -1, -1, -1,
+        -1, 8, -1,
+        -1, -1, -1
+    };
+};
+
+struct EmbossTaps
+{
+    static constexpr int Size = 3;
+    static constexpr int Divisor = 1;
+    static constexpr int Offset = 128;
+    static constexpr int Taps[Size * Size] = {
+        -2, -1, 0,
+        -1, 1, 1,
+        0, 1, 2
+    };
+};
+
+inline int channelAt(QRgb pixel, int shift) { return (pixel >> shift) & 0xff; }
+inline int channelAt(uchar pixel, int) { return pixel; }
+
+// Convolution with the taps of Kernel. The tap loop is expanded at compile
+// time, zero taps are dropped and the sums are exact integers, so the
+// divisor is a constant the compiler turns into a multiply and shift.
+template <typename Kernel>
+struct FixedConvolution
+{
+    static constexpr int Size = Kernel::Size;
+    static constexpr int Radius = Size / 2;
+    
+    // Truncating the quotient and adding the offset afterwards is only the
+    // generic paths' trunc(sum / divisor + offset) when one of them is trivial
+    static_assert(Kernel::Divisor == 1 || Kernel::Offset == 0, "offset needs a unit divisor");
+    
+    static int pack(int sum) {
+        return qBound(0, sum / Kernel::Divisor + Kernel::Offset, 255);
+    }
+    
+    // Weighted sum of one channel; tap (ky, kx) reads rows[ky][x + kx]
+    template <typename Pixel, int... Tap>
+    static int sum(const Pixel *const *rows, int x, int shift, std::integer_sequence<int, Tap...>) {
+        return (0 + ... + (Kernel::Taps[Tap] == 0 ? 0
+                           : Kernel::Taps[Tap] * channelAt(rows[Tap / Size][x + Tap % Size], shift)));
+    }
+    
+    // Total weight of the taps of one sign
+    static constexpr int weight(int sign) {
+        int total = 0;
+        for (int tap : Kernel::Taps) {
+            total += tap * sign > 0 ? tap * sign : 0;
+        }
+        return total;
+    }
+    
+    // Red and blue are summed side by side in the two 16-bit halves of a
+    // word, taps of each sign apart, so neither half can carry into the other
+    static_assert(weight(1) * 255 < 65536 && weight(-1) * 255 < 65536, "taps too large to pair channels");
+    
+    template <int Sign, int... Tap>
+    static quint32 redBlueSum(const QRgb *const *rows, int x, std::integer_sequence<int, Tap...>) {
+        return (0u + ... + (Kernel::Taps[Tap] * Sign <= 0 ? 0u
+                            : static_cast<quint32>(Kernel::Taps[Tap] * Sign) *
+                              (rows[Tap / Size][x + Tap % Size] & 0x00ff00ffu)));
+    }
+    
+    static QRgb pixel(const QRgb *const *rows, int x, QRgb center) {
+        auto taps = std::make_integer_sequence<int, Size * Size>();
+        quint32 positive = redBlueSum<1>(rows, x, taps);
+        quint32 negative = redBlueSum<-1>(rows, x, taps);
+        int red = static_cast<int>(positive >> 16) - static_cast<int>(negative >> 16);
+        int blue = static_cast<int>(positive & 0xffff) - static_cast<int>(negative & 0xffff);
+        return qRgba(pack(red), pack(sum(rows, x, 8, taps)), pack(blue), qAlpha(center));
+    }
+    
+    static uchar pixel(const uchar *const *rows, int x, uchar) {
+        return static_cast<uchar>(pack(sum(rows, x, 0, std::make_integer_sequence<int, Size * Size>())));
+    }
+    
+    template <typename Source, typename Target>
+    static void apply(const Source &src, Target &dst, const BorderExtension &border,
+                      int firstRow, int endRow) {
+        typedef PixelOf<Source> Pixel;
+        int width = src.width();
+        
+        std::vector<Pixel> constantRow(width);
+        border.fillConstant(constantRow.data(), width);
+        
+        const Pixel *rows[Size];
+        Pixel window[Size * Size]; // Extended neighbourhood of an edge pixel
+        const Pixel *windowRows[Size];
+        for (int ky = 0; ky < Size; ++ky) {
+            windowRows[ky] = window + ky * Size;
+        }
+        
+        for (int y = firstRow; y < endRow; ++y) {
+            if (FilterJob::isCancelled()) {
+                return;
+            }
+            for (int ky = 0; ky < Size; ++ky) {
+                rows[ky] = rowAt(src, border, y + ky - Radius, constantRow.data());
+            }
+            const Pixel *in = src.row(y);
+            Pixel *out = dst.row(y);
+            
+            auto edge = [&](int x) {
+                for (int ky = 0; ky < Size; ++ky) {
+                    border.extendRow(rows[ky], width, Radius - x, Size, window + ky * Size);
+                }
+                out[x] = pixel(windowRows, 0, in[x]);
+            };
+            
+            int interiorStart = qMin(Radius, width);
+            int interiorEnd = qMax(interiorStart, width - Radius);
+            for (int x = 0; x < interiorStart; ++x) {
+                edge(x);
+            }
+            for (int x = interiorStart; x < interiorEnd; ++x) {
+                out[x] = pixel(rows, x - Radius, in[x]);
+            }
+            for (int x = interiorEnd; x < width; ++x) {
+                edge(x);
+            }
+        }
+    }
+};
+
+} // namespace
+
+struct ConvolutionFilter::FixedKernel
+{
+    QVector<QVector<double>> kernel;
+    double divisor;
+    double offset;
+    int radius;
+    void (*applyColor)(const ConstPixelView &, PixelView &, const BorderExtension &, int, int);
+    void (*applyGray)(const ConstGrayView &, GrayView &, const BorderExtension &, int, int);
+    
+    void apply(const ConstPixelView &src, PixelView &dst, const BorderExtension &border,
+               int firstRow, int endRow) const {
+        applyColor(src, dst, border, firstRow, endRow);
+    }
+    
+    void apply(const ConstGrayView &src, GrayView &dst, const BorderExtension &border,
+               int firstRow, int endRow) const {
+        applyGray(src, dst, border, firstRow, endRow);
+    }
+};
+
+// The kernel of a preset as the generic paths take it
+template <typename Kernel>
+static QVector<QVector<double>> fixedKernelTaps() {
+    QVector<QVector<double>> kernel(Kernel::Size, QVector<double>(Kernel::Size));
+    for (int ky = 0; ky < Kernel::Size; ++ky) {
+        for (int kx = 0; kx < Kernel::Size; ++kx) {
+            kernel[ky][kx] = Kernel::Taps[ky * Kernel::Size + kx];
+        }
+    }
+    return kernel;
+}
+
+template <typename Kernel>
+const ConvolutionFilter::FixedKernel *ConvolutionFilter::fixedKernelFor() {
+    typedef FixedConvolution<Kernel> Convolution;
+    static const FixedKernel fixed = {
+        fixedKernelTaps<Kernel>(),
+        static_cast<double>(Kernel::Divisor),
+        static_cast<double>(Kernel::Offset),
+        Convolution::Radius,
+        &Convolution::template apply<ConstPixelView, PixelView>,
+        &Convolution::template apply<ConstGrayView, GrayView>
+    };
+    return &fixed;
+}
+
 // Base ConvolutionFilter implementation
 ConvolutionFilter::ConvolutionFilter(const QString &name, 
                                    const QVector<QVector<double>> &kernel,
                                    double divisor,
                                    double offset)
-    : name(name), kernel(kernel), divisor(divisor), offset(offset)
+    : name(name), kernel(kernel), divisor(divisor), offset(offset), separableEnabled(true),
+      frequencyEnabled(true), fixedKernel(nullptr)
 {
     // Set default anchor to center of kernel
     anchorX = kernel.isEmpty() ? 0 : kernel[0].size() / 2;
     anchorY = kernel.size() / 2;
+    
+    detectSeparability();
 }
 
 ConvolutionFilter::~ConvolutionFilter() {}
@@ -31,6 +583,8 @@ void ConvolutionFilter::setKernel(const QVector<QVector<double>> &kernel) {
     // Update anchor point
     anchorX = kernel.isEmpty() ? 0 : kernel[0].size() / 2;
     anchorY = kernel.size() / 2;
+    
+    detectSeparability();
 }
 
 double ConvolutionFilter::getDivisor() const {
@@ -65,6 +619,18 @@ void ConvolutionFilter::setAnchorY(int y) {
     anchorY = y;
 }
 
+BorderExtension::Mode ConvolutionFilter::getBoundaryMode() const {
+    return border.getMode();
+}
+
+QRgb ConvolutionFilter::getBoundaryColor() const {
+    return border.getColor();
+}
+
+void ConvolutionFilter::setBoundaryMode(BorderExtension::Mode mode, QRgb color) {
+    border = BorderExtension(mode, color);
+}
+
 double ConvolutionFilter::calculateKernelSum() const {
     double sum = 0.0;
     for (const auto &row : kernel) {
@@ -75,94 +641,549 @@ double ConvolutionFilter::calculateKernelSum() const {
     return sum;
 }
 
-QImage ConvolutionFilter::apply(const QImage &image) {
-    QImage result = image.copy();
+bool ConvolutionFilter::isSeparable() const {
+    return separable;
+}
+
+void ConvolutionFilter::setSeparableEnabled(bool enabled) {
+    separableEnabled = enabled;
+}
+
+bool ConvolutionFilter::isSeparableEnabled() const {
+    return separableEnabled;
+}
+
+bool ConvolutionFilter::usesFrequencyDomain() const {
+    if (!frequencyEnabled || (separable && separableEnabled)) {
+        return false;
+    }
     
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            result.setPixel(x, y, applyToPixel(image, x, y));
+    int taps = kernel.size() * maxKernelWidth();
+    int forced = forcedFrequencyThreshold.loadRelaxed();
+    if (forced >= 0) {
+        return taps >= forced;
+    }
+    return taps >= MinimumFrequencyTaps && taps >= frequencyThreshold();
+}
+
+bool ConvolutionFilter::usesFixedKernel() const {
+    return fixedKernel && kernel == fixedKernel->kernel && divisor == fixedKernel->divisor &&
+           offset == fixedKernel->offset && anchorX == fixedKernel->radius &&
+           anchorY == fixedKernel->radius;
+}
+
+void ConvolutionFilter::setFrequencyDomainEnabled(bool enabled) {
+    frequencyEnabled = enabled;
+}
+
+bool ConvolutionFilter::isFrequencyDomainEnabled() const {
+    return frequencyEnabled;
+}
+
+void ConvolutionFilter::setFrequencyThreshold(int taps) {
+    forcedFrequencyThreshold.storeRelaxed(qMax(-1, taps));
+}
+
+int ConvolutionFilter::frequencyThreshold() {
+    int forced = forcedFrequencyThreshold.loadRelaxed();
+    if (forced >= 0) {
+        return forced;
+    }
+    
+    static const int measured = measureFrequencyThreshold();
+    return measured;
+}
+
+int ConvolutionFilter::measureFrequencyThreshold() {
+    // Time both paths on a synthetic image with growing dense kernels; the
+    // first size the FFT path wins at is the threshold for this machine.
+    // The probe runs outside the caller's job, so cancelling that job cannot
+    // cut a timing short.
+    FilterJob::Scope outsideJob(nullptr);
+    const int side = 256;
+    QImage image(side, side, QImage::Format_RGB32);
+    for (int y = 0; y < side; ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < side; ++x) {
+            line[x] = qRgb((x * 7 + y * 13) & 255, (x * x + y) & 255, (x ^ y) & 255);
+        }
+    }
+    
+    ConstPixelView src(image);
+    QImage result = PixelView::createResult(src);
+    PixelView dst(result);
+    
+    static const int sizes[] = { 7, 9, 11, 15, 19, 25, 31, 41, 51, 63 };
+    for (int size : sizes) {
+        QVector<QVector<double>> probeKernel(size, QVector<double>(size));
+        for (int ky = 0; ky < size; ++ky) {
+            for (int kx = 0; kx < size; ++kx) {
+                probeKernel[ky][kx] = (ky * 5 + kx * kx * 3) % 7 - 3;
+            }
+        }
+        ConvolutionFilter probe("Probe", probeKernel);
+        
+        qint64 spatial = std::numeric_limits<qint64>::max();
+        qint64 frequency = std::numeric_limits<qint64>::max();
+        for (int run = 0; run < 2; ++run) {
+            QElapsedTimer timer;
+            timer.start();
+            ParallelExecutor::forEachRowBand(side, [&](int firstRow, int endRow) {
+                probe.applyDirect<float>(src, dst, firstRow, endRow);
+            });
+            spatial = qMin(spatial, timer.nsecsElapsed());
+            
+            timer.restart();
+            probe.applyFrequency(src, dst);
+            frequency = qMin(frequency, timer.nsecsElapsed());
+        }
+        
+        if (frequency < spatial) {
+            return size * size;
+        }
+    }
+    return std::numeric_limits<int>::max();
+}
+
+void ConvolutionFilter::detectSeparability() {
+    separable = false;
+    columnFactors.clear();
+    rowFactors.clear();
+    
+    if (kernel.isEmpty() || kernel[0].isEmpty()) {
+        return;
+    }
+    
+    // Pivot on the largest coefficient; every row must have the same width
+    int rows = kernel.size();
+    int cols = kernel[0].size();
+    int pivotX = 0;
+    int pivotY = 0;
+    double maxAbs = 0.0;
+    
+    for (int ky = 0; ky < rows; ++ky) {
+        if (kernel[ky].size() != cols) {
+            return;
+        }
+        for (int kx = 0; kx < cols; ++kx) {
+            if (std::abs(kernel[ky][kx]) > maxAbs) {
+                maxAbs = std::abs(kernel[ky][kx]);
+                pivotX = kx;
+                pivotY = ky;
+            }
+        }
+    }
+    
+    if (maxAbs == 0.0) {
+        return;
+    }
+    
+    // Integer kernels factor into integer vectors: the pivot row divided by
+    // the gcd of its entries. That keeps both passes exact, so they match the
+    // 2D path bit for bit. Other kernels are normalized by the pivot.
+    double rowScale = kernel[pivotY][pivotX];
+    if (isIntegralKernel(kernel)) {
+        long long rowGcd = 0;
+        for (int kx = 0; kx < cols; ++kx) {
+            rowGcd = std::gcd(rowGcd, static_cast<long long>(std::abs(kernel[pivotY][kx])));
+        }
+        rowScale = static_cast<double>(rowGcd);
+    }
+    
+    QVector<double> column(rows);
+    QVector<double> row(cols);
+    for (int ky = 0; ky < rows; ++ky) {
+        column[ky] = kernel[ky][pivotX] * rowScale / kernel[pivotY][pivotX];
+    }
+    for (int kx = 0; kx < cols; ++kx) {
+        row[kx] = kernel[pivotY][kx] / rowScale;
+    }
+    
+    // The outer product must reproduce the whole kernel
+    for (int ky = 0; ky < rows; ++ky) {
+        for (int kx = 0; kx < cols; ++kx) {
+            if (std::abs(kernel[ky][kx] - column[ky] * row[kx]) > SeparableTolerance * maxAbs) {
+                return;
+            }
         }
     }
     
+    separable = true;
+    columnFactors = column;
+    rowFactors = row;
+}
+
+QImage ConvolutionFilter::apply(const QImage &image) {
+    // Gray images keep a single channel and do a third of the work
+    if (GrayView::isGrayFormat(image)) {
+        ConstGrayView src(image);
+        QImage result = GrayView::createResult(src);
+        GrayView dst(result);
+        applyToView(src, dst);
+        return result;
+    }
+    
+    ConstPixelView src(image);
+    QImage result = PixelView::createResult(src);
+    PixelView dst(result);
+    applyToView(src, dst);
+    
+    // Every channel goes through the same arithmetic, but on the FFT path
+    // only integer kernels round every channel of a gray pixel alike. A
+    // coloured constant border makes the result coloured.
+    if (border.isGray() && (!usesFrequencyDomain() || isIntegralKernel(kernel))) {
+        ImageMetadata::copyGrayscale(image, result);
+    }
     return result;
 }
 
-QRgb ConvolutionFilter::applyToPixel(const QImage &image, int x, int y) {
-    double sumR = 0.0, sumG = 0.0, sumB = 0.0;
+template <typename Source, typename Target>
+void ConvolutionFilter::applyToView(const Source &src, Target &dst) {
+    if (usesFixedKernel()) {
+        ParallelExecutor::forEachRowBand(src.height(), [&](int firstRow, int endRow) {
+            fixedKernel->apply(src, dst, border, firstRow, endRow);
+        });
+        return;
+    }
     
-    for (int ky = 0; ky < kernel.size(); ++ky) {
-        for (int kx = 0; kx < kernel[ky].size(); ++kx) {
-            int imageX = x + kx - anchorX;
-            int imageY = y + ky - anchorY;
-            
-            QRgb pixel = getPixelWithBoundary(image, imageX, imageY);
-            
-            sumR += qRed(pixel) * kernel[ky][kx];
-            sumG += qGreen(pixel) * kernel[ky][kx];
-            sumB += qBlue(pixel) * kernel[ky][kx];
+    if (usesFrequencyDomain()) {
+        applyFrequency(src, dst);
+        return;
+    }
+    
+    bool twoPass = separable && separableEnabled;
+    bool wide = needsDoubleSums();
+    
+    // Bands write disjoint rows, so the result matches a serial run exactly
+    ParallelExecutor::forEachRowBand(src.height(), [&](int firstRow, int endRow) {
+        if (twoPass && wide) {
+            applySeparable<double>(src, dst, firstRow, endRow);
+        } else if (twoPass) {
+            applySeparable<float>(src, dst, firstRow, endRow);
+        } else if (wide) {
+            applyDirect<double>(src, dst, firstRow, endRow);
+        } else {
+            applyDirect<float>(src, dst, firstRow, endRow);
         }
+    });
+}
+
+bool ConvolutionFilter::needsDoubleSums() const {
+    double magnitude = 0.0;
+    for (const auto &row : kernel) {
+        for (double value : row) {
+            magnitude += std::abs(value);
+        }
+    }
+    return magnitude * 255.0 >= FloatExactLimit;
+}
+
+int ConvolutionFilter::maxKernelWidth() const {
+    int cols = 0;
+    for (const auto &row : kernel) {
+        cols = qMax(cols, static_cast<int>(row.size()));
     }
+    return cols;
+}
+
+template <typename Sum, typename Source, typename Target>
+void ConvolutionFilter::applyDirect(const Source &src, Target &dst, int firstRow, int endRow) {
+    int width = src.width();
+    int rows = kernel.size();
+    int channels = channelCount(src);
+    
+    // Padded rows hold the extended source pixel of every tap, so tap kx of
+    // output x is element x + kx and each tap is one contiguous vector op
+    int length = width + qMax(maxKernelWidth(), 1) - 1;
+    std::vector<PixelOf<Source>> padded(length);
+    std::vector<PixelOf<Source>> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
     
-    int r = qBound(0, static_cast<int>(sumR / divisor + offset), 255);
-    int g = qBound(0, static_cast<int>(sumG / divisor + offset), 255);
-    int b = qBound(0, static_cast<int>(sumB / divisor + offset), 255);
+    // Padded planar rows, cached in slot position % rows. The positions
+    // under the kernel are consecutive, so they land in distinct slots.
+    std::vector<Sum> cache(static_cast<size_t>(rows) * length * channels);
+    std::vector<int> cachedRow(rows, NoRow);
+    std::vector<const Sum *> lines(rows);
+    std::vector<Sum> sums(static_cast<size_t>(width) * channels);
     
-    return qRgba(r, g, b, qAlpha(image.pixel(x, y)));
+    for (int y = firstRow; y < endRow; ++y) {
+        if (FilterJob::isCancelled()) {
+            return;
+        }
+        for (int ky = 0; ky < rows; ++ky) {
+            int position = y + ky - anchorY;
+            int slot = rowSlot(position, rows);
+            Sum *line = cache.data() + static_cast<size_t>(slot) * length * channels;
+            if (cachedRow[slot] != position) {
+                border.extendRow(rowAt(src, border, position, constantRow.data()), width, anchorX, length,
+                                 padded.data());
+                loadPlanes(padded.data(), length, line);
+                cachedRow[slot] = position;
+            }
+            lines[ky] = line;
+        }
+        
+        std::fill(sums.begin(), sums.end(), Sum(0));
+        for (int ky = 0; ky < rows; ++ky) {
+            for (int kx = 0; kx < kernel[ky].size(); ++kx) {
+                Sum weight = static_cast<Sum>(kernel[ky][kx]);
+                if (weight == Sum(0)) {
+                    continue;
+                }
+                for (int c = 0; c < channels; ++c) {
+                    ConvolutionBackend::accumulate(sums.data() + c * width,
+                                                   lines[ky] + c * length + kx,
+                                                   weight, width);
+                }
+            }
+        }
+        
+        packSums(sums.data(), width, src.row(y), dst.row(y), divisor, offset);
+    }
 }
 
-QRgb ConvolutionFilter::getPixelWithBoundary(const QImage &image, int x, int y) {
-    // Handle boundary conditions (mirror at edges)
-    if (x < 0) x = -x;
-    if (y < 0) y = -y;
-    if (x >= image.width()) x = 2 * image.width() - x - 1;
-    if (y >= image.height()) y = 2 * image.height() - y - 1;
+template <typename Sum, typename Source, typename Target>
+void ConvolutionFilter::applySeparable(const Source &src, Target &dst, int firstRow, int endRow) {
+    int width = src.width();
+    int rows = columnFactors.size();
+    int cols = rowFactors.size();
+    int channels = channelCount(src);
+    
+    int length = width + cols - 1;
+    std::vector<PixelOf<Source>> padded(length);
+    std::vector<PixelOf<Source>> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
     
-    return image.pixel(x, y);
+    // Horizontally filtered planar rows, cached in slot position % rows
+    std::vector<Sum> planes(static_cast<size_t>(length) * channels);
+    std::vector<Sum> cache(static_cast<size_t>(rows) * width * channels);
+    std::vector<int> cachedRow(rows, NoRow);
+    std::vector<const Sum *> lines(rows);
+    std::vector<Sum> sums(static_cast<size_t>(width) * channels);
+    
+    for (int y = firstRow; y < endRow; ++y) {
+        if (FilterJob::isCancelled()) {
+            return;
+        }
+        for (int ky = 0; ky < rows; ++ky) {
+            int position = y + ky - anchorY;
+            int slot = rowSlot(position, rows);
+            Sum *line = cache.data() + static_cast<size_t>(slot) * width * channels;
+            if (cachedRow[slot] != position) {
+                border.extendRow(rowAt(src, border, position, constantRow.data()), width, anchorX, length,
+                                 padded.data());
+                loadPlanes(padded.data(), length, planes.data());
+                filterRowHorizontally(planes.data(), length, width, channels, line);
+                cachedRow[slot] = position;
+            }
+            lines[ky] = line;
+        }
+        
+        // Vertical pass
+        std::fill(sums.begin(), sums.end(), Sum(0));
+        for (int ky = 0; ky < rows; ++ky) {
+            Sum factor = static_cast<Sum>(columnFactors[ky]);
+            if (factor == Sum(0)) {
+                continue;
+            }
+            ConvolutionBackend::accumulate(sums.data(), lines[ky], factor, width * channels);
+        }
+        
+        packSums(sums.data(), width, src.row(y), dst.row(y), divisor, offset);
+    }
+}
+
+template <typename Sum>
+void ConvolutionFilter::filterRowHorizontally(const Sum *padded, int length, int width, int channels, Sum *line) {
+    std::fill(line, line + static_cast<size_t>(width) * channels, Sum(0));
+    for (int kx = 0; kx < rowFactors.size(); ++kx) {
+        Sum factor = static_cast<Sum>(rowFactors[kx]);
+        if (factor == Sum(0)) {
+            continue;
+        }
+        for (int c = 0; c < channels; ++c) {
+            ConvolutionBackend::accumulate(line + c * width, padded + c * length + kx, factor, width);
+        }
+    }
+}
+
+void ConvolutionFilter::applyFrequency(const ConstPixelView &src, PixelView &dst) {
+    typedef FourierTransform::Complex Complex;
+    
+    int width = src.width();
+    int height = src.height();
+    int rows = kernel.size();
+    int cols = maxKernelWidth();
+    
+    // Overlap-save: each tile reads a mirrored source window and keeps the
+    // outputs whose taps did not wrap around
+    int tileSize = chooseTileSize(width, height, rows, cols);
+    int outputWidth = tileSize - cols + 1;
+    int outputHeight = tileSize - rows + 1;
+    int tilesX = (width + outputWidth - 1) / outputWidth;
+    int tilesY = (height + outputHeight - 1) / outputHeight;
+    size_t area = static_cast<size_t>(tileSize) * tileSize;
+    FourierTransform fft(tileSize);
+    std::vector<Complex> spectrum = kernelSpectrum(kernel, fft);
+    
+    bool integral = isIntegralKernel(kernel);
+    auto channel = [&](double sum) {
+        return packFrequencySum(sum, integral, divisor, offset);
+    };
+    
+    std::vector<QRgb> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
+    
+    ParallelExecutor::forEach(tilesX * tilesY, [&](int tile) {
+        int x0 = (tile % tilesX) * outputWidth;
+        int y0 = (tile / tilesX) * outputHeight;
+        
+        // The kernel is real, so red and green share one transform as its
+        // real and imaginary parts and come back separated the same way
+        std::vector<Complex> redGreen(area);
+        std::vector<Complex> blue(area);
+        std::vector<QRgb> padded(tileSize);
+        for (int i = 0; i < tileSize; ++i) {
+            border.extendRow(rowAt(src, border, y0 + i - anchorY, constantRow.data()), width,
+                             anchorX - x0, tileSize, padded.data());
+            Complex *rg = redGreen.data() + static_cast<size_t>(i) * tileSize;
+            Complex *b = blue.data() + static_cast<size_t>(i) * tileSize;
+            for (int j = 0; j < tileSize; ++j) {
+                QRgb pixel = padded[j];
+                rg[j] = Complex(qRed(pixel), qGreen(pixel));
+                b[j] = Complex(qBlue(pixel), 0.0);
+            }
+        }
+        
+        fft.forward2D(redGreen.data());
+        fft.forward2D(blue.data());
+        for (size_t i = 0; i < area; ++i) {
+            redGreen[i] = FourierTransform::multiply(redGreen[i], spectrum[i]);
+            blue[i] = FourierTransform::multiply(blue[i], spectrum[i]);
+        }
+        fft.inverse2D(redGreen.data());
+        fft.inverse2D(blue.data());
+        
+        int endY = qMin(outputHeight, height - y0);
+        int endX = qMin(outputWidth, width - x0);
+        for (int y = 0; y < endY; ++y) {
+            const QRgb *in = src.row(y0 + y);
+            QRgb *out = dst.row(y0 + y);
+            const Complex *rg = redGreen.data() + static_cast<size_t>(y) * tileSize;
+            const Complex *b = blue.data() + static_cast<size_t>(y) * tileSize;
+            for (int x = 0; x < endX; ++x) {
+                out[x0 + x] = qRgba(channel(rg[x].real()), channel(rg[x].imag()),
+                                    channel(b[x].real()), qAlpha(in[x0 + x]));
+            }
+        }
+    });
+}
+
+void ConvolutionFilter::applyFrequency(const ConstGrayView &src, GrayView &dst) {
+    typedef FourierTransform::Complex Complex;
+    
+    int width = src.width();
+    int height = src.height();
+    int rows = kernel.size();
+    int cols = maxKernelWidth();
+    
+    int tileSize = chooseTileSize(width, height, rows, cols);
+    int outputWidth = tileSize - cols + 1;
+    int outputHeight = tileSize - rows + 1;
+    int tilesX = (width + outputWidth - 1) / outputWidth;
+    int tilesY = (height + outputHeight - 1) / outputHeight;
+    int tiles = tilesX * tilesY;
+    size_t area = static_cast<size_t>(tileSize) * tileSize;
+    FourierTransform fft(tileSize);
+    std::vector<Complex> spectrum = kernelSpectrum(kernel, fft);
+    bool integral = isIntegralKernel(kernel);
+    
+    std::vector<uchar> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
+    
+    // With one channel, two tiles share a transform as its real and
+    // imaginary parts
+    ParallelExecutor::forEach((tiles + 1) / 2, [&](int pair) {
+        int firstTile = 2 * pair;
+        int count = qMin(2, tiles - firstTile);
+        
+        std::vector<Complex> data(area);
+        std::vector<uchar> padded(tileSize);
+        for (int t = 0; t < count; ++t) {
+            int x0 = ((firstTile + t) % tilesX) * outputWidth;
+            int y0 = ((firstTile + t) / tilesX) * outputHeight;
+            for (int i = 0; i < tileSize; ++i) {
+                border.extendRow(rowAt(src, border, y0 + i - anchorY, constantRow.data()), width,
+                                 anchorX - x0, tileSize, padded.data());
+                Complex *line = data.data() + static_cast<size_t>(i) * tileSize;
+                for (int j = 0; j < tileSize; ++j) {
+                    if (t == 0) {
+                        line[j] = Complex(padded[j], 0.0);
+                    } else {
+                        line[j].imag(padded[j]);
+                    }
+                }
+            }
+        }
+        
+        fft.forward2D(data.data());
+        for (size_t i = 0; i < area; ++i) {
+            data[i] = FourierTransform::multiply(data[i], spectrum[i]);
+        }
+        fft.inverse2D(data.data());
+        
+        for (int t = 0; t < count; ++t) {
+            int x0 = ((firstTile + t) % tilesX) * outputWidth;
+            int y0 = ((firstTile + t) / tilesX) * outputHeight;
+            int endY = qMin(outputHeight, height - y0);
+            int endX = qMin(outputWidth, width - x0);
+            for (int y = 0; y < endY; ++y) {
+                uchar *out = dst.row(y0 + y);
+                const Complex *line = data.data() + static_cast<size_t>(y) * tileSize;
+                for (int x = 0; x < endX; ++x) {
+                    double sum = t == 0 ? line[x].real() : line[x].imag();
+                    out[x0 + x] = static_cast<uchar>(packFrequencySum(sum, integral, divisor, offset));
+                }
+            }
+        }
+    });
 }
 
 // BlurFilter implementation
 BlurFilter::BlurFilter() 
-    : ConvolutionFilter("Blur", {
-        {1, 1, 1},
-        {1, 1, 1},
-        {1, 1, 1}
-    }, 9.0, 0.0) {}
+    : ConvolutionFilter("Blur", fixedKernelTaps<BlurTaps>(), BlurTaps::Divisor, BlurTaps::Offset) {
+    fixedKernel = fixedKernelFor<BlurTaps>();
+}
 
 // GaussianBlurFilter implementation
 GaussianBlurFilter::GaussianBlurFilter() 
-    : ConvolutionFilter("Gaussian Blur", {
-        {1, 2, 1},
-        {2, 4, 2},
-        {1, 2, 1}
-    }, 16.0, 0.0) {}
+    : ConvolutionFilter("Gaussian Blur", fixedKernelTaps<GaussianBlurTaps>(),
+                        GaussianBlurTaps::Divisor, GaussianBlurTaps::Offset) {
+    fixedKernel = fixedKernelFor<GaussianBlurTaps>();
+}
 
 // SharpenFilter implementation
 SharpenFilter::SharpenFilter() 
-    : ConvolutionFilter("Sharpen", {
-        {0, -1, 0},
-        {-1, 5, -1},
-        {0, -1, 0}
-    }, 1.0, 0.0) {}
+    : ConvolutionFilter("Sharpen", fixedKernelTaps<SharpenTaps>(), SharpenTaps::Divisor, SharpenTaps::Offset) {
+    fixedKernel = fixedKernelFor<SharpenTaps>();
+}
 
 // EdgeDetectionFilter implementation
 EdgeDetectionFilter::EdgeDetectionFilter() 
-    : ConvolutionFilter("Edge Detection", {
-        {-1, -1, -1},
-        {-1, 8, -1},
-        {-1, -1, -1}
-    }, 1.0, 0.0) {}
+    : ConvolutionFilter("Edge Detection", fixedKernelTaps<EdgeDetectionTaps>(),
+                        EdgeDetectionTaps::Divisor, EdgeDetectionTaps::Offset) {
+    fixedKernel = fixedKernelFor<EdgeDetectionTaps>();
+}
 
 // EmbossFilter implementation
 EmbossFilter::EmbossFilter() 
-    : ConvolutionFilter("Emboss", {
-        {-2, -1, 0},
-        {-1, 1, 1},
-        {0, 1, 2}
-    }, 1.0, 128.0) {}
+    : ConvolutionFilter("Emboss", fixedKernelTaps<EmbossTaps>(), EmbossTaps::Divisor, EmbossTaps::Offset) {
+    fixedKernel = fixedKernelFor<EmbossTaps>();
+}
 
 // MedianFilter implementation
 MedianFilter::MedianFilter(int size)
-    : name("Median Filter"), size(size)
+    : name("Median Filter"), size(size), method(AUTOMATIC)
 {
     // Ensure size is odd
     if (size % 2 == 0) {
@@ -189,61 +1210,300 @@ void MedianFilter::setSize(int size) {
     }
 }
 
+MedianFilter::Method MedianFilter::getMethod() const {
+    return method;
+}
+
+void MedianFilter::setMethod(Method method) {
+    this->method = method;
+}
+
+BorderExtension::Mode MedianFilter::getBoundaryMode() const {
+    return border.getMode();
+}
+
+QRgb MedianFilter::getBoundaryColor() const {
+    return border.getColor();
+}
+
+void MedianFilter::setBoundaryMode(BorderExtension::Mode mode, QRgb color) {
+    border = BorderExtension(mode, color);
+}
+
 QImage MedianFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            result.setPixel(x, y, applyToPixel(image, x, y));
-        }
+    // Gray images keep a single channel and do a third of the work
+    if (GrayView::isGrayFormat(image)) {
+        ConstGrayView src(image);
+        QImage result = GrayView::createResult(src);
+        GrayView dst(result);
+        applyToView(src, dst);
+        return result;
     }
     
+    ConstPixelView src(image);
+    QImage result = PixelView::createResult(src);
+    PixelView dst(result);
+    applyToView(src, dst);
+    
+    if (border.isGray()) {
+        ImageMetadata::copyGrayscale(image, result);
+    }
     return result;
 }
 
-QRgb MedianFilter::applyToPixel(const QImage &image, int x, int y) {
-    std::vector<int> redValues;
-    std::vector<int> greenValues;
-    std::vector<int> blueValues;
+template <typename Source, typename Target>
+void MedianFilter::applyToView(const Source &src, Target &dst) {
+    // Sizes without a network use histograms, which beat sorting at any size
+    bool network = (method == AUTOMATIC || method == NETWORK) && (size == 3 || size == 5);
+    bool histogram = !network && method != SORT;
     
-    int halfSize = size / 2;
+    ParallelExecutor::forEachRowBand(src.height(), [&](int firstRow, int endRow) {
+        if (network) {
+            applyNetwork(src, dst, firstRow, endRow);
+            return;
+        }
+        if (histogram) {
+            applyHistogram(src, dst, firstRow, endRow);
+            return;
+        }
+        
+        applySort(src, dst, firstRow, endRow);
+    });
+}
+
+template <typename Source, typename Target>
+void MedianFilter::applySort(const Source &src, Target &dst, int firstRow, int endRow) {
+    int width = src.width();
+    int radius = size / 2;
+    int channels = channelCount(src);
     
-    // Collect all pixel values in the neighborhood
-    for (int ky = -halfSize; ky <= halfSize; ++ky) {
-        for (int kx = -halfSize; kx <= halfSize; ++kx) {
-            int imageX = x + kx;
-            int imageY = y + ky;
-            
-            QRgb pixel = getPixelWithBoundary(image, imageX, imageY);
-            
-            redValues.push_back(qRed(pixel));
-            greenValues.push_back(qGreen(pixel));
-            blueValues.push_back(qBlue(pixel));
+    // Padded planar rows of the window, cached in slot position % size
+    int length = width + 2 * radius;
+    std::vector<PixelOf<Source>> padded(length);
+    std::vector<PixelOf<Source>> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
+    std::vector<uchar> cache(static_cast<size_t>(size) * channels * length);
+    std::vector<int> cachedRow(size, NoRow);
+    std::vector<const uchar *> lines(size);
+    
+    std::vector<uchar> values(static_cast<size_t>(size) * size);
+    std::vector<uchar> medians(static_cast<size_t>(channels) * width);
+    
+    for (int y = firstRow; y < endRow; ++y) {
+        if (FilterJob::isCancelled()) {
+            return;
+        }
+        for (int ky = 0; ky < size; ++ky) {
+            int position = y + ky - radius;
+            int slot = rowSlot(position, size);
+            uchar *plane = cache.data() + static_cast<size_t>(slot) * channels * length;
+            if (cachedRow[slot] != position) {
+                border.extendRow(rowAt(src, border, position, constantRow.data()), width, radius, length,
+                                 padded.data());
+                loadPlanes(padded.data(), length, plane);
+                cachedRow[slot] = position;
+            }
+            lines[ky] = plane;
+        }
+        
+        for (int c = 0; c < channels; ++c) {
+            uchar *median = medians.data() + static_cast<size_t>(c) * width;
+            for (int x = 0; x < width; ++x) {
+                for (int ky = 0; ky < size; ++ky) {
+                    std::memcpy(values.data() + ky * size, lines[ky] + c * length + x, size);
+                }
+                auto middle = values.begin() + values.size() / 2;
+                std::nth_element(values.begin(), middle, values.end());
+                median[x] = *middle;
+            }
         }
+        storePlanes(medians.data(), width, src.row(y), dst.row(y), width);
+    }
+}
+
+template <typename Source, typename Target>
+void MedianFilter::applyHistogram(const Source &src, Target &dst, int firstRow, int endRow) {
+    int width = src.width();
+    int radius = size / 2;
+    int channels = channelCount(src);
+    
+    // The sorted neighbourhood's middle element is the first value whose
+    // cumulative count exceeds this
+    int target = size * size / 2;
+    
+    // Padded column p of the window reads source column sourceX[p]. Column
+    // width is an extra one that holds the border colour in every row.
+    std::vector<int> sourceX(width + 2 * radius);
+    for (int p = 0; p < width + 2 * radius; ++p) {
+        int x = border.sourceIndex(p - radius, width);
+        sourceX[p] = x >= 0 ? x : width;
+    }
+    
+    std::vector<MedianHistogram> histograms(channels, MedianHistogram(width + 1));
+    int constant[3];
+    PixelOf<Source> constantPixel;
+    border.fillConstant(&constantPixel, 1);
+    loadChannels(constantPixel, constant);
+    for (int c = 0; c < channels; ++c) {
+        histograms[c].updateColumn(width, constant[c], size);
     }
     
-    // Sort the values and find the median
-    std::sort(redValues.begin(), redValues.end());
-    std::sort(greenValues.begin(), greenValues.end());
-    std::sort(blueValues.begin(), blueValues.end());
+    std::vector<PixelOf<Source>> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
+    
+    auto updateRow = [&](int position, int delta) {
+        const auto *in = rowAt(src, border, position, constantRow.data());
+        int values[3];
+        for (int x = 0; x < width; ++x) {
+            loadChannels(in[x], values);
+            for (int c = 0; c < channels; ++c) {
+                histograms[c].updateColumn(x, values[c], delta);
+            }
+        }
+    };
     
-    int medianIndex = redValues.size() / 2;
+    std::vector<uchar> medians(static_cast<size_t>(channels) * width);
     
-    int r = redValues[medianIndex];
-    int g = greenValues[medianIndex];
-    int b = blueValues[medianIndex];
+    // Extended rows may repeat; the column histograms simply count them twice
+    for (int ky = -radius; ky <= radius; ++ky) {
+        updateRow(firstRow + ky, 1);
+    }
     
-    return qRgba(r, g, b, qAlpha(image.pixel(x, y)));
+    for (int y = firstRow; y < endRow; ++y) {
+        if (FilterJob::isCancelled()) {
+            return;
+        }
+        if (y > firstRow) {
+            updateRow(y - radius - 1, -1);
+            updateRow(y + radius, 1);
+        }
+        
+        // Channel planes of the output row
+        for (int c = 0; c < channels; ++c) {
+            histograms[c].startRow(sourceX.data(), size);
+            uchar *median = medians.data() + static_cast<size_t>(c) * width;
+            for (int x = 0; x < width; ++x) {
+                median[x] = histograms[c].median(x, sourceX.data(), size, target);
+            }
+        }
+        storePlanes(medians.data(), width, src.row(y), dst.row(y), width);
+    }
 }
 
-QRgb MedianFilter::getPixelWithBoundary(const QImage &image, int x, int y) {
-    // Handle boundary conditions (mirror at edges)
-    if (x < 0) x = -x;
-    if (y < 0) y = -y;
-    if (x >= image.width()) x = 2 * image.width() - x - 1;
-    if (y >= image.height()) y = 2 * image.height() - y - 1;
+template <typename Source, typename Target>
+void MedianFilter::applyNetwork(const Source &src, Target &dst, int firstRow, int endRow) {
+    int width = src.width();
+    int radius = size / 2;
+    int channels = channelCount(src);
     
-    return image.pixel(x, y);
+    // Padded planar rows, rounded up to whole lane blocks; the columns past
+    // the image only feed outputs that are never stored
+    int outputLength = (width + MedianLanes - 1) / MedianLanes * MedianLanes;
+    int length = (outputLength + 2 * radius + MedianLanes - 1) / MedianLanes * MedianLanes;
+    std::vector<PixelOf<Source>> padded(length);
+    std::vector<PixelOf<Source>> constantRow(width);
+    border.fillConstant(constantRow.data(), width);
+    
+    // Channel planes of padded rows, cached in slot position % size
+    std::vector<uchar> cache(static_cast<size_t>(size) * channels * length);
+    std::vector<int> cachedRow(size, NoRow);
+    std::vector<const uchar *> lines(size);
+    
+    // Window columns sorted top to bottom: ranks[k * length + p] is the k-th
+    // smallest value of padded column p. Each column sort is shared by the
+    // size outputs whose window contains it.
+    std::vector<uchar> ranks(static_cast<size_t>(size) * length);
+    std::vector<uchar> medians(static_cast<size_t>(channels) * outputLength);
+    uchar v[25][MedianLanes];
+    
+    for (int y = firstRow; y < endRow; ++y) {
+        if (FilterJob::isCancelled()) {
+            return;
+        }
+        int slots[5];
+        for (int ky = 0; ky < size; ++ky) {
+            int position = y + ky - radius;
+            int slot = rowSlot(position, size);
+            uchar *plane = cache.data() + static_cast<size_t>(slot) * channels * length;
+            if (cachedRow[slot] != position) {
+                border.extendRow(rowAt(src, border, position, constantRow.data()), width, radius, length,
+                                 padded.data());
+                loadPlanes(padded.data(), length, plane);
+                cachedRow[slot] = position;
+            }
+            slots[ky] = slot;
+        }
+        
+        for (int c = 0; c < channels; ++c) {
+            for (int ky = 0; ky < size; ++ky) {
+                lines[ky] = cache.data() + (static_cast<size_t>(slots[ky]) * channels + c) * length;
+            }
+            
+            for (int p = 0; p < length; p += MedianLanes) {
+                for (int ky = 0; ky < size; ++ky) {
+                    std::memcpy(v[ky], lines[ky] + p, MedianLanes);
+                }
+                if (size == 3) {
+                    sortLanes(v[0], v[1]);
+                    sortLanes(v[1], v[2]);
+                    sortLanes(v[0], v[1]);
+                } else {
+                    sortLanes(v[0], v[1]);
+                    sortLanes(v[3], v[4]);
+                    sortLanes(v[2], v[4]);
+                    sortLanes(v[2], v[3]);
+                    sortLanes(v[0], v[3]);
+                    sortLanes(v[0], v[2]);
+                    sortLanes(v[1], v[4]);
+                    sortLanes(v[1], v[3]);
+                    sortLanes(v[1], v[2]);
+                }
+                for (int k = 0; k < size; ++k) {
+                    std::memcpy(ranks.data() + static_cast<size_t>(k) * length + p, v[k], MedianLanes);
+                }
+            }
+            
+            uchar *median = medians.data() + static_cast<size_t>(c) * outputLength;
+            for (int x = 0; x < outputLength; x += MedianLanes) {
+                for (int column = 0; column < size; ++column) {
+                    for (int k = 0; k < size; ++k) {
+                        std::memcpy(v[column * size + k],
+                                    ranks.data() + static_cast<size_t>(k) * length + x + column,
+                                    MedianLanes);
+                    }
+                }
+                
+                if (size == 3) {
+                    // Median of nine from sorted columns: the median of the
+                    // largest minimum, the middle median and the smallest maximum
+                    maxLanes(v[0], v[3]);
+                    maxLanes(v[3], v[6]);
+                    sortLanes(v[1], v[4]);
+                    minLanes(v[4], v[7]);
+                    maxLanes(v[1], v[4]);
+                    minLanes(v[5], v[2]);
+                    minLanes(v[8], v[5]);
+                    sortLanes(v[6], v[4]);
+                    minLanes(v[4], v[8]);
+                    maxLanes(v[6], v[4]);
+                    std::memcpy(median + x, v[4], MedianLanes);
+                } else {
+                    for (const Comparator &comparator : Median25Network) {
+                        if (comparator.step == SORT_PAIR) {
+                            sortLanes(v[comparator.a], v[comparator.b]);
+                        } else if (comparator.step == KEEP_MIN) {
+                            minLanes(v[comparator.a], v[comparator.b]);
+                        } else {
+                            maxLanes(v[comparator.a], v[comparator.b]);
+                        }
+                    }
+                    std::memcpy(median + x, v[12], MedianLanes);
+                }
+            }
+        }
+        
+        storePlanes(medians.data(), outputLength, src.row(y), dst.row(y), width);
+    }
 }
 
 // CustomFilter implementation
@@ -0,0 +1,417 @@
+#include "filters/filtergraph.h"
+#include "filters/filterjob.h"
+#include "filters/imagemetadata.h"
+#include "filters/parallelexecutor.h"
+#include "filters/pixelview.h"
+#include <QHash>
+#include <QJsonArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <cmath>
+
+// Node name of the image the graph is applied to
+static const char *const InputId = "input";
+
+static const char *const BlendFilter = "blend";
+
+// Blend weight from a number or numeric text
+static bool blendWeight(const QJsonObject &parameters, double &weight, QString &error)
+{
+    weight = 0.5;
+    for (auto it = parameters.constBegin(); it != parameters.constEnd(); ++it) {
+        if (it.key() != "weight") {
+            error = QString("blend: unknown parameter '%1'").arg(it.key());
+            return false;
+        }
+        QJsonValue value = it.value();
+        bool ok = value.isDouble();
+        weight = ok ? value.toDouble() : value.toString().toDouble(&ok);
+        if (!ok || !std::isfinite(weight)) {
+            error = "blend: invalid weight (a number)";
+            return false;
+        }
+    }
+    return true;
+}
+
+FilterGraph::FilterGraph()
+    : output(-1)
+{
+}
+
+FilterGraph FilterGraph::fromJson(const QJsonObject &object, QString &error) {
+    FilterGraph graph;
+    QJsonArray nodeArray = object.value("nodes").toArray();
+    if (nodeArray.isEmpty()) {
+        error = "the graph has no nodes";
+        return FilterGraph();
+    }
+    
+    // Nodes in file order first
+    QVector<Node> nodes;
+    QHash<QString, int> indices;
+    for (const QJsonValue &value : nodeArray) {
+        QJsonObject nodeObject = value.toObject();
+        Node node;
+        node.id = nodeObject.value("id").toString();
+        node.blend = false;
+        node.weight = 0.5;
+        if (node.id.isEmpty() || node.id == InputId || indices.contains(node.id)) {
+            error = QString("invalid or repeated node id '%1'").arg(node.id);
+            return FilterGraph();
+        }
+        
+        QString filter = nodeObject.value("filter").toString();
+        QJsonObject parameters = nodeObject.value("params").toObject();
+        QString nodeError;
+        if (filter == BlendFilter) {
+            node.blend = true;
+            if (!blendWeight(parameters, node.weight, nodeError)) {
+                error = QString("%1: %2").arg(node.id, nodeError);
+                return FilterGraph();
+            }
+        } else {
+            node.step = FilterStep::create(filter, parameters, nodeError);
+            if (!node.step.isValid()) {
+                error = QString("%1: %2").arg(node.id, nodeError);
+                return FilterGraph();
+            }
+        }
+        
+        indices.insert(node.id, nodes.size());
+        nodes.append(node);
+    }
+    
+    // Inputs in the order of their edges
+    QVector<int> consumers(nodes.size(), 0);
+    for (const QJsonValue &value : object.value("edges").toArray()) {
+        QJsonObject edge = value.toObject();
+        QString from = edge.value("from").toString();
+        QString to = edge.value("to").toString();
+        if (!indices.contains(to) || (from != InputId && !indices.contains(from))) {
+            error = QString("edge from '%1' to '%2' names an unknown node").arg(from, to);
+            return FilterGraph();
+        }
+        int source = from == InputId ? Source : indices.value(from);
+        nodes[indices.value(to)].inputs.append(source);
+        if (source != Source) {
+            ++consumers[source];
+        }
+    }
+    
+    for (const Node &node : nodes) {
+        int expected = node.blend ? 2 : 1;
+        if (node.inputs.size() != expected) {
+            error = QString("%1: needs %2 incoming edge(s), has %3")
+                        .arg(node.id).arg(expected).arg(node.inputs.size());
+            return FilterGraph();
+        }
+    }
+    
+    // The named output, or else the one node nothing reads
+    int output = -1;
+    if (object.contains("output")) {
+        output = indices.value(object.value("output").toString(), -1);
+        if (output < 0) {
+            error = QString("unknown output node '%1'").arg(object.value("output").toString());
+            return FilterGraph();
+        }
+    } else {
+        for (int i = 0; i < nodes.size(); ++i) {
+            if (consumers[i] == 0) {
+                if (output >= 0) {
+                    error = "several nodes could be the output; name one with \"output\"";
+                    return FilterGraph();
+                }
+                output = i;
+            }
+        }
+        if (output < 0) {
+            error = "the edges form a cycle";
+            return FilterGraph();
+        }
+    }
+    
+    // Depth-first from the output: nodes it does not depend on are dropped,
+    // the rest are ordered after their inputs
+    enum Mark { UNVISITED, VISITING, DONE };
+    QVector<int> marks(nodes.size(), UNVISITED);
+    QVector<int> order;
+    std::function<bool(int)> visit = [&](int index) {
+        if (marks[index] == DONE) {
+            return true;
+        }
+        if (marks[index] == VISITING) {
+            return false;
+        }
+        marks[index] = VISITING;
+        for (int input : nodes[index].inputs) {
+            if (input != Source && !visit(input)) {
+                return false;
+            }
+        }
+        marks[index] = DONE;
+        order.append(index);
+        return true;
+    };
+    if (!visit(output)) {
+        error = "the edges form a cycle";
+        return FilterGraph();
+    }
+    
+    QVector<int> position(nodes.size(), -1);
+    for (int i = 0; i < order.size(); ++i) {
+        position[order[i]] = i;
+    }
+    for (int index : order) {
+        Node node = nodes[index];
+        for (int &input : node.inputs) {
+            if (input != Source) {
+                input = position[input];
+            }
+        }
+        graph.nodes.append(node);
+    }
+    graph.name = object.value("name").toString();
+    graph.output = position[output];
+    return graph;
+}
+
+QJsonObject FilterGraph::toJson() const {
+    QJsonArray nodeArray;
+    QJsonArray edgeArray;
+    for (const Node &node : nodes) {
+        QJsonObject nodeObject;
+        nodeObject["id"] = node.id;
+        if (node.blend) {
+            QJsonObject parameters;
+            parameters["weight"] = node.weight;
+            nodeObject["filter"] = BlendFilter;
+            nodeObject["params"] = parameters;
+        } else {
+            nodeObject["filter"] = node.step.getName();
+            nodeObject["params"] = node.step.getParameters();
+        }
+        nodeArray.append(nodeObject);
+        
+        for (int input : node.inputs) {
+            QJsonObject edge;
+            edge["from"] = input == Source ? QString(InputId) : nodes[input].id;
+            edge["to"] = node.id;
+            edgeArray.append(edge);
+        }
+    }
+    
+    QJsonObject object;
+    object["name"] = name;
+    object["nodes"] = nodeArray;
+    object["edges"] = edgeArray;
+    if (output >= 0) {
+        object["output"] = nodes[output].id;
+    }
+    return object;
+}
+
+FilterGraph FilterGraph::fromSteps(const QVector<FilterStep> &steps) {
+    FilterGraph graph;
+    for (int i = 0; i < steps.size(); ++i) {
+        Node node;
+        node.id = QString("%1-%2").arg(steps[i].getName()).arg(i + 1);
+        node.step = steps[i];
+        node.blend = false;
+        node.weight = 0.5;
+        node.inputs.append(i == 0 ? Source : i - 1);
+        graph.nodes.append(node);
+    }
+    graph.output = graph.nodes.size() - 1;
+    return graph;
+}
+
+bool FilterGraph::isGraph(const QJsonObject &object) {
+    return object.contains("nodes");
+}
+
+bool FilterGraph::isValid() const {
+    return output >= 0;
+}
+
+QString FilterGraph::getName() const {
+    return name;
+}
+
+void FilterGraph::setName(const QString &name) {
+    this->name = name;
+}
+
+int FilterGraph::nodeCount() const {
+    return nodes.size();
+}
+
+QImage FilterGraph::apply(const QImage &image) const {
+    if (!isValid()) {
+        return image;
+    }
+    
+    int count = nodes.size();
+    QVector<QImage> results(count);
+    QVector<int> waiting(count, 0);   // Inputs not computed yet
+    QVector<int> consumers(count, 0); // Reads still to come of each result
+    QVector<QVector<int>> readers(count);
+    for (int i = 0; i < count; ++i) {
+        for (int input : nodes[i].inputs) {
+            if (input != Source) {
+                ++waiting[i];
+                ++consumers[input];
+                readers[input].append(i);
+            }
+        }
+    }
+    ++consumers[output];
+    
+    QVector<int> ready;
+    for (int i = 0; i < count; ++i) {
+        if (waiting[i] == 0) {
+            ready.append(i);
+        }
+    }
+    
+    FilterJob *owner = FilterJob::current();
+    QMutex mutex;
+    QWaitCondition changed;
+    int running = 0;
+    int finished = 0;
+    
+    // Called with the mutex held
+    auto inputOf = [&](int index, int slot) {
+        int input = nodes[index].inputs.value(slot, Source);
+        return input == Source ? image : results[input];
+    };
+    auto run = [&](int index, const QImage &first, const QImage &second) {
+        const Node &node = nodes[index];
+        return node.blend ? blend(first, second, node.weight) : node.step.apply(first);
+    };
+    auto complete = [&](int index, const QImage &result) {
+        results[index] = result;
+        for (int input : nodes[index].inputs) {
+            if (input != Source && --consumers[input] == 0) {
+                results[input] = QImage();
+            }
+        }
+        for (int reader : readers[index]) {
+            if (--waiting[reader] == 0) {
+                ready.append(reader);
+            }
+        }
+        --running;
+        ++finished;
+    };
+    
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, qMin(count, QThread::idealThreadCount())));
+    
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        bool cancelled = owner && owner->isCancelRequested();
+        if (finished == count || (cancelled && running == 0)) {
+            break;
+        }
+        
+        // A lone node runs here, without handing it to the pool
+        if (!cancelled && ready.size() == 1 && running == 0) {
+            int index = ready.takeFirst();
+            QImage first = inputOf(index, 0);
+            QImage second = inputOf(index, 1);
+            ++running;
+            locker.unlock();
+            QImage result = run(index, first, second);
+            first = QImage();
+            second = QImage();
+            locker.relock();
+            complete(index, result);
+            continue;
+        }
+        
+        while (!cancelled && !ready.isEmpty()) {
+            int index = ready.takeFirst();
+            QImage first = inputOf(index, 0);
+            QImage second = inputOf(index, 1);
+            ++running;
+            pool.start([&, index, first, second]() {
+                FilterJob::Scope scope(owner);
+                QImage result = run(index, first, second);
+                QMutexLocker locker(&mutex);
+                complete(index, result);
+                changed.wakeAll();
+            });
+        }
+        changed.wait(&mutex);
+    }
+    locker.unlock();
+    pool.waitForDone();
+    
+    if (finished < count || (owner && owner->isCancelRequested())) {
+        return QImage();
+    }
+    return results[output];
+}
+
+QImage FilterGraph::blend(const QImage &first, const QImage &second, double weight) {
+    if (first.size() != second.size()) {
+        return first;
+    }
+    
+    bool gray = ImageMetadata::isMarkedGrayscale(first) && ImageMetadata::isMarkedGrayscale(second);
+    auto mix = [weight](int a, int b) {
+        return qBound(0, qRound(a + weight * (b - a)), 255);
+    };
+    
+    if (GrayView::isGrayFormat(first) && GrayView::isGrayFormat(second)) {
+        ConstGrayView a(first);
+        ConstGrayView b(second);
+        QImage result = GrayView::createResult(a);
+        GrayView out(result);
+        ParallelExecutor::forEachRowBand(out.height(), [&](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; ++y) {
+                const uchar *rowA = a.row(y);
+                const uchar *rowB = b.row(y);
+                uchar *rowOut = out.row(y);
+                for (int x = 0; x < out.width(); ++x) {
+                    rowOut[x] = static_cast<uchar>(mix(rowA[x], rowB[x]));
+                }
+            }
+        });
+        ImageMetadata::setGrayscale(result, gray);
+        return result;
+    }
+    
+    // Both in the same 32-bit layout, with alpha if either has it
+    QImage left = PixelView::normalize(first);
+    QImage right = PixelView::normalize(second);
+    if (left.format() != right.format()) {
+        left = left.convertToFormat(QImage::Format_ARGB32);
+        right = right.convertToFormat(QImage::Format_ARGB32);
+    }
+    
+    ConstPixelView a(left);
+    ConstPixelView b(right);
+    QImage result = PixelView::createResult(a);
+    PixelView out(result);
+    ParallelExecutor::forEachRowBand(out.height(), [&](int firstRow, int endRow) {
+        for (int y = firstRow; y < endRow; ++y) {
+            const QRgb *rowA = a.row(y);
+            const QRgb *rowB = b.row(y);
+            QRgb *rowOut = out.row(y);
+            for (int x = 0; x < out.width(); ++x) {
+                rowOut[x] = qRgba(mix(qRed(rowA[x]), qRed(rowB[x])),
+                                  mix(qGreen(rowA[x]), qGreen(rowB[x])),
+                                  mix(qBlue(rowA[x]), qBlue(rowB[x])),
+                                  mix(qAlpha(rowA[x]), qAlpha(rowB[x])));
+            }
+        }
+    });
+    ImageMetadata::setGrayscale(result, gray);
+    return result;
+}
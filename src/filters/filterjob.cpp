@@ -0,0 +1,56 @@
+#include "filters/filterjob.h"
+
+static thread_local FilterJob *currentJob = nullptr;
+
+FilterJob::FilterJob()
+    : cancelled(0), total(0), finished(0), percent(0)
+{
+}
+
+void FilterJob::cancel() {
+    cancelled.storeRelease(1);
+}
+
+bool FilterJob::isCancelRequested() const {
+    return cancelled.loadAcquire() != 0;
+}
+
+void FilterJob::setProgressHandler(const std::function<void(int)> &handler) {
+    progressHandler = handler;
+}
+
+void FilterJob::addWork(int items) {
+    total.fetchAndAddRelaxed(items);
+}
+
+void FilterJob::finishWork(int items) {
+    int done = finished.fetchAndAddRelaxed(items) + items;
+    int all = total.loadRelaxed();
+    if (all <= 0 || !progressHandler) {
+        return;
+    }
+    
+    // Later passes announce their work as they start, so the value can drop
+    int value = static_cast<int>(static_cast<qint64>(qMin(done, all)) * 100 / all);
+    if (percent.fetchAndStoreRelaxed(value) != value) {
+        progressHandler(value);
+    }
+}
+
+FilterJob *FilterJob::current() {
+    return currentJob;
+}
+
+bool FilterJob::isCancelled() {
+    return currentJob && currentJob->isCancelRequested();
+}
+
+FilterJob::Scope::Scope(FilterJob *job)
+    : previous(currentJob)
+{
+    currentJob = job;
+}
+
+FilterJob::Scope::~Scope() {
+    currentJob = previous;
+}
@@ -0,0 +1,444 @@
+#include "filters/filterregistry.h"
+#include "filters/functionfilters.h"
+#include "filters/convolutionfilters.h"
+#include <QJsonArray>
+#include <cmath>
+
+namespace {
+
+const QStringList BorderChoices = { "mirror", "clamp", "wrap", "constant" };
+
+// Largest custom kernel, rows or columns
+const int MaximumKernelSide = 255;
+
+// Largest weighted sum of a convolution after dividing
+const double MaximumSum = 1e9;
+
+// Lower case without separators, so "Floyd-Steinberg" matches floydsteinberg
+QString choiceKey(const QString &text)
+{
+    QString key;
+    for (QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            key += c.toLower();
+        }
+    }
+    return key;
+}
+
+QStringList ditherChoices()
+{
+    QStringList choices;
+    for (const QString &name : DitheringFilter::getKernelNames()) {
+        choices.append(choiceKey(name));
+    }
+    return choices;
+}
+
+int integer(const QJsonObject &parameters, const QString &name)
+{
+    return qRound(parameters.value(name).toDouble());
+}
+
+double number(const QJsonObject &parameters, const QString &name)
+{
+    return parameters.value(name).toDouble();
+}
+
+BorderExtension::Mode borderMode(const QJsonObject &parameters)
+{
+    int index = qMax(0, BorderChoices.indexOf(parameters.value("border").toString()));
+    return static_cast<BorderExtension::Mode>(index);
+}
+
+QVector<QVector<double>> kernelOf(const QJsonValue &value)
+{
+    QVector<QVector<double>> kernel;
+    for (const QJsonValue &row : value.toArray()) {
+        QVector<double> cells;
+        for (const QJsonValue &cell : row.toArray()) {
+            cells.append(cell.toDouble());
+        }
+        kernel.append(cells);
+    }
+    return kernel;
+}
+
+// Rows separated by ';', cells by spaces
+bool parseKernel(const QString &text, QJsonArray &kernel)
+{
+    for (const QString &line : text.split(';', Qt::SkipEmptyParts)) {
+        QJsonArray row;
+        for (const QString &cell : line.split(' ', Qt::SkipEmptyParts)) {
+            bool ok = false;
+            double value = cell.toDouble(&ok);
+            if (!ok) {
+                return false;
+            }
+            row.append(value);
+        }
+        if (!row.isEmpty()) {
+            kernel.append(row);
+        }
+    }
+    return !kernel.isEmpty();
+}
+
+bool isRectangularKernel(const QJsonArray &kernel)
+{
+    if (kernel.isEmpty()) {
+        return false;
+    }
+    int columns = kernel.first().toArray().size();
+    if (kernel.size() > MaximumKernelSide || columns > MaximumKernelSide) {
+        return false;
+    }
+    for (const QJsonValue &row : kernel) {
+        if (!row.isArray() || row.toArray().size() != columns || columns == 0) {
+            return false;
+        }
+        for (const QJsonValue &cell : row.toArray()) {
+            if (!cell.isDouble() || !std::isfinite(cell.toDouble())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// The divisor given, or for 0 the kernel sum, or 1 if that is 0
+double divisorOf(const QVector<QVector<double>> &kernel, double divisor)
+{
+    if (divisor != 0.0) {
+        return divisor;
+    }
+    CustomFilter probe("Custom", kernel);
+    double sum = probe.calculateKernelSum();
+    return std::abs(sum) < 0.00001 ? 1.0 : sum;
+}
+
+// Anchors inside the kernel, and weighted sums that stay far from the int
+// range the filters convert them to
+bool checkConvolution(const QJsonObject &parameters, QString &error)
+{
+    QVector<QVector<double>> kernel = kernelOf(parameters.value("kernel"));
+    if (integer(parameters, "anchorX") >= kernel.first().size() ||
+        integer(parameters, "anchorY") >= kernel.size()) {
+        error = "anchor outside the kernel";
+        return false;
+    }
+    
+    double magnitude = 0.0;
+    for (const QVector<double> &row : kernel) {
+        for (double cell : row) {
+            magnitude += std::abs(cell);
+        }
+    }
+    if (magnitude * 255.0 / std::abs(divisorOf(kernel, number(parameters, "divisor"))) > MaximumSum) {
+        error = "divisor too small for the kernel";
+        return false;
+    }
+    return true;
+}
+
+QImage applyConvolution(ConvolutionFilter &filter, const QImage &image, const QJsonObject &parameters)
+{
+    filter.setBoundaryMode(borderMode(parameters));
+    return filter.apply(image);
+}
+
+FilterRegistry::Parameter borderParameter()
+{
+    return { "border", QString("mirror"), BorderChoices, "How pixels past the image edge are read" };
+}
+
+QVector<FilterRegistry::Operation> createOperations()
+{
+    QVector<FilterRegistry::Operation> operations;
+    
+    operations.append({ "invert", "Invert every channel", {},
+        [](const QImage &image, const QJsonObject &) {
+            InversionFilter filter;
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "brightness", "Add a constant to every channel",
+        { { "factor", 50.0, {}, "Amount added, -255 to 255", -255.0, 255.0 } },
+        [](const QImage &image, const QJsonObject &p) {
+            BrightnessFilter filter(number(p, "factor"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "contrast", "Scale every channel around mid gray",
+        { { "factor", 1.0, {}, "Scale, 0 to 3", 0.0, 3.0 } },
+        [](const QImage &image, const QJsonObject &p) {
+            ContrastFilter filter(number(p, "factor"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "gamma", "Gamma correction",
+        { { "gamma", 1.0, {}, "Gamma, 0.1 to 10", 0.1, 10.0 } },
+        [](const QImage &image, const QJsonObject &p) {
+            GammaFilter filter(number(p, "gamma"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "grayscale", "Convert to gray (ITU-R BT.601 weights)", {},
+        [](const QImage &image, const QJsonObject &) {
+            GrayscaleFilter filter;
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "quantize", "Uniform quantization to a number of levels per channel",
+        { { "red", 8.0, {}, "Red levels, 2 to 256", 2.0, 256.0 },
+          { "green", 8.0, {}, "Green levels, 2 to 256", 2.0, 256.0 },
+          { "blue", 8.0, {}, "Blue levels, 2 to 256", 2.0, 256.0 } },
+        [](const QImage &image, const QJsonObject &p) {
+            UniformQuantizationFilter filter;
+            filter.setLevels(integer(p, "red"), integer(p, "green"), integer(p, "blue"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "dither", "Quantization with error diffusion or a threshold matrix",
+        { { "red", 2.0, {}, "Red levels, 2 to 256", 2.0, 256.0 },
+          { "green", 2.0, {}, "Green levels, 2 to 256", 2.0, 256.0 },
+          { "blue", 2.0, {}, "Blue levels, 2 to 256", 2.0, 256.0 },
+          { "kernel", ditherChoices().first(), ditherChoices(), "Diffusion kernel or threshold matrix" } },
+        [](const QImage &image, const QJsonObject &p) {
+            DitheringFilter filter;
+            filter.setLevels(integer(p, "red"), integer(p, "green"), integer(p, "blue"));
+            filter.setKernelType(static_cast<DitheringFilter::KernelType>(
+                qMax(0, ditherChoices().indexOf(p.value("kernel").toString()))));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "hue", "Rotate the hue",
+        { { "degrees", 0.0, {}, "Rotation in degrees" } },
+        [](const QImage &image, const QJsonObject &p) {
+            HueRotationFilter filter(number(p, "degrees"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "saturation", "Scale the saturation",
+        { { "gain", 1.0, {}, "Gain, 0 for gray, up to 10", 0.0, 10.0 } },
+        [](const QImage &image, const QJsonObject &p) {
+            SaturationFilter filter(number(p, "gain"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "value", "Scale the value with a gamma curve",
+        { { "gain", 1.0, {}, "Gain, 0 to 10", 0.0, 10.0 },
+          { "gamma", 1.0, {}, "Gamma, 0.1 to 10", 0.1, 10.0 } },
+        [](const QImage &image, const QJsonObject &p) {
+            ValueFilter filter(number(p, "gain"), number(p, "gamma"));
+            return filter.apply(image);
+        } });
+    
+    operations.append({ "blur", "3x3 box blur", { borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            BlurFilter filter;
+            return applyConvolution(filter, image, p);
+        } });
+    
+    operations.append({ "gaussian-blur", "3x3 Gaussian blur", { borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            GaussianBlurFilter filter;
+            return applyConvolution(filter, image, p);
+        } });
+    
+    operations.append({ "sharpen", "3x3 sharpening", { borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            SharpenFilter filter;
+            return applyConvolution(filter, image, p);
+        } });
+    
+    operations.append({ "edge-detection", "3x3 Laplacian edge detection", { borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            EdgeDetectionFilter filter;
+            return applyConvolution(filter, image, p);
+        } });
+    
+    operations.append({ "emboss", "3x3 emboss", { borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            EmbossFilter filter;
+            return applyConvolution(filter, image, p);
+        } });
+    
+    operations.append({ "convolution", "Convolution with a custom kernel",
+        { { "kernel", QJsonArray { QJsonValue(QJsonArray { 1.0 }) }, {}, "Rows of coefficients" },
+          { "divisor", 0.0, {}, "Divisor; 0 uses the kernel sum, or 1 if that is 0" },
+          { "offset", 0.0, {}, "Added after dividing, -255 to 255", -255.0, 255.0 },
+          { "anchorX", -1.0, {}, "Anchor column; -1 for the centre", -1.0, MaximumKernelSide - 1.0 },
+          { "anchorY", -1.0, {}, "Anchor row; -1 for the centre", -1.0, MaximumKernelSide - 1.0 },
+          borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            QVector<QVector<double>> kernel = kernelOf(p.value("kernel"));
+            CustomFilter filter("Custom", kernel, divisorOf(kernel, number(p, "divisor")), number(p, "offset"));
+            if (integer(p, "anchorX") >= 0) {
+                filter.setAnchorX(integer(p, "anchorX"));
+            }
+            if (integer(p, "anchorY") >= 0) {
+                filter.setAnchorY(integer(p, "anchorY"));
+            }
+            return applyConvolution(filter, image, p);
+        },
+        checkConvolution });
+    
+    operations.append({ "median", "Median of a square window",
+        { { "size", 3.0, {}, "Window side, odd, 1 to 99", 1.0, 99.0 },
+          borderParameter() },
+        [](const QImage &image, const QJsonObject &p) {
+            MedianFilter filter(qMax(1, integer(p, "size")));
+            filter.setBoundaryMode(borderMode(p));
+            return filter.apply(image);
+        } });
+    
+    return operations;
+}
+
+} // namespace
+
+const QVector<FilterRegistry::Operation> &FilterRegistry::operations() {
+    static const QVector<Operation> list = createOperations();
+    return list;
+}
+
+const FilterRegistry::Operation *FilterRegistry::find(const QString &name) {
+    for (const Operation &operation : operations()) {
+        if (operation.name == name) {
+            return &operation;
+        }
+    }
+    return nullptr;
+}
+
+bool FilterRegistry::resolve(const Operation &operation, const QJsonObject &given,
+                             QJsonObject &parameters, QString &error) {
+    parameters = QJsonObject();
+    
+    for (auto it = given.constBegin(); it != given.constEnd(); ++it) {
+        bool known = false;
+        for (const Parameter &parameter : operation.parameters) {
+            known = known || parameter.name == it.key();
+        }
+        if (!known) {
+            error = QString("%1: unknown parameter '%2'").arg(operation.name, it.key());
+            return false;
+        }
+    }
+    
+    for (const Parameter &parameter : operation.parameters) {
+        QJsonValue value = given.contains(parameter.name) ? given.value(parameter.name) : parameter.defaultValue;
+        QString invalid = QString("%1: invalid %2").arg(operation.name, parameter.name);
+        
+        if (!parameter.choices.isEmpty()) {
+            // A name, or an index into the choices
+            bool numeric = value.isDouble();
+            int index = numeric ? (std::abs(value.toDouble()) < parameter.choices.size() ? qRound(value.toDouble()) : -1)
+                                : value.toString().toInt(&numeric);
+            if (!numeric) {
+                index = parameter.choices.indexOf(choiceKey(value.toString()));
+            }
+            if (index < 0 || index >= parameter.choices.size()) {
+                error = invalid + QString(" (one of %1)").arg(parameter.choices.join(", "));
+                return false;
+            }
+            value = parameter.choices[index];
+        } else if (parameter.defaultValue.isArray()) {
+            QJsonArray kernel = value.toArray();
+            if (value.isString() && !parseKernel(value.toString(), kernel)) {
+                error = invalid;
+                return false;
+            }
+            if (!isRectangularKernel(kernel)) {
+                error = invalid + QString(" (rows of equal length, at most %1 by %1)").arg(MaximumKernelSide);
+                return false;
+            }
+            value = kernel;
+        } else {
+            bool ok = value.isDouble();
+            double number = ok ? value.toDouble() : value.toString().toDouble(&ok);
+            if (!ok || !std::isfinite(number)) {
+                error = invalid + " (a number)";
+                return false;
+            }
+            if (number < parameter.minimum || number > parameter.maximum) {
+                error = invalid + QString(" (%1 to %2)").arg(parameter.minimum).arg(parameter.maximum);
+                return false;
+            }
+            value = number;
+        }
+        
+        parameters.insert(parameter.name, value);
+    }
+    
+    if (operation.check && !operation.check(parameters, error)) {
+        error = QString("%1: %2").arg(operation.name, error);
+        return false;
+    }
+    return true;
+}
+
+FilterStep::FilterStep()
+    : operation(nullptr)
+{
+}
+
+FilterStep FilterStep::create(const QString &name, const QJsonObject &parameters, QString &error) {
+    FilterStep step;
+    const FilterRegistry::Operation *operation = FilterRegistry::find(name);
+    if (!operation) {
+        error = QString("unknown filter '%1'").arg(name);
+        return step;
+    }
+    
+    if (FilterRegistry::resolve(*operation, parameters, step.parameters, error)) {
+        step.operation = operation;
+    }
+    return step;
+}
+
+FilterStep FilterStep::parse(const QString &spec, QString &error) {
+    int colon = spec.indexOf(':');
+    QString name = spec.left(colon < 0 ? spec.size() : colon).trimmed();
+    const FilterRegistry::Operation *operation = FilterRegistry::find(name);
+    if (!operation) {
+        error = QString("unknown filter '%1'").arg(name);
+        return FilterStep();
+    }
+    
+    // Values without a key fill the parameters in order
+    QJsonObject given;
+    if (colon >= 0) {
+        QStringList values = spec.mid(colon + 1).split(',', Qt::SkipEmptyParts);
+        for (int i = 0; i < values.size(); ++i) {
+            int equals = values[i].indexOf('=');
+            if (equals >= 0) {
+                given.insert(values[i].left(equals).trimmed(), values[i].mid(equals + 1).trimmed());
+            } else if (i < operation->parameters.size()) {
+                given.insert(operation->parameters[i].name, values[i].trimmed());
+            } else {
+                error = QString("%1: too many values").arg(name);
+                return FilterStep();
+            }
+        }
+    }
+    
+    return create(name, given, error);
+}
+
+bool FilterStep::isValid() const {
+    return operation != nullptr;
+}
+
+QString FilterStep::getName() const {
+    return operation ? operation->name : QString();
+}
+
+QJsonObject FilterStep::getParameters() const {
+    return parameters;
+}
+
+QImage FilterStep::apply(const QImage &image) const {
+    return operation ? operation->apply(image, parameters) : image;
+}
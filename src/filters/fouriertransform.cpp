@@ -0,0 +1,112 @@
+#include "filters/fouriertransform.h"
+#include <QtGlobal>
+#include <cmath>
+#include <utility>
+
+FourierTransform::FourierTransform(int size)
+    : size(size), bitReverse(size), twiddles(size), inverseTwiddles(size)
+{
+    Q_ASSERT(isPowerOfTwo(size));
+    
+    int bits = 0;
+    while ((1 << bits) < size) {
+        ++bits;
+    }
+    for (int i = 0; i < size; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReverse[i] = reversed;
+    }
+    
+    // Stage of length L reads its L / 2 twiddles contiguously from index L / 2
+    for (int length = 2; length <= size; length <<= 1) {
+        int half = length / 2;
+        for (int k = 0; k < half; ++k) {
+            double angle = -2.0 * M_PI * k / length;
+            twiddles[half + k] = Complex(std::cos(angle), std::sin(angle));
+            inverseTwiddles[half + k] = std::conj(twiddles[half + k]);
+        }
+    }
+}
+
+int FourierTransform::getSize() const {
+    return size;
+}
+
+void FourierTransform::forward(Complex *data) const {
+    transform(data, false);
+}
+
+void FourierTransform::inverse(Complex *data) const {
+    transform(data, true);
+}
+
+void FourierTransform::forward2D(Complex *data) const {
+    transform2D(data, false);
+}
+
+void FourierTransform::inverse2D(Complex *data) const {
+    transform2D(data, true);
+}
+
+FourierTransform::Complex FourierTransform::multiply(const Complex &a, const Complex &b) {
+    // Plain product; std::complex's operator* adds slow NaN/inf recovery
+    return Complex(a.real() * b.real() - a.imag() * b.imag(),
+                   a.real() * b.imag() + a.imag() * b.real());
+}
+
+bool FourierTransform::isPowerOfTwo(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+int FourierTransform::nextPowerOfTwo(int value) {
+    int power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+void FourierTransform::transform(Complex *data, bool inverse) const {
+    for (int i = 0; i < size; ++i) {
+        int j = bitReverse[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    
+    // Iterative Cooley-Tukey butterflies
+    const Complex *table = inverse ? inverseTwiddles.data() : twiddles.data();
+    for (int length = 2; length <= size; length <<= 1) {
+        int half = length / 2;
+        const Complex *w = table + half;
+        for (int start = 0; start < size; start += length) {
+            for (int k = 0; k < half; ++k) {
+                Complex u = data[start + k];
+                Complex v = multiply(data[start + k + half], w[k]);
+                data[start + k] = u + v;
+                data[start + k + half] = u - v;
+            }
+        }
+    }
+}
+
+void FourierTransform::transform2D(Complex *data, bool inverse) const {
+    for (int y = 0; y < size; ++y) {
+        transform(data + static_cast<size_t>(y) * size, inverse);
+    }
+    
+    // Columns are gathered into a contiguous line to keep the butterflies cache-friendly
+    std::vector<Complex> column(size);
+    for (int x = 0; x < size; ++x) {
+        for (int y = 0; y < size; ++y) {
+            column[y] = data[static_cast<size_t>(y) * size + x];
+        }
+        transform(column.data(), inverse);
+        for (int y = 0; y < size; ++y) {
+            data[static_cast<size_t>(y) * size + x] = column[y];
+        }
+    }
+}
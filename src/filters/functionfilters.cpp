@@ -1,6 +1,202 @@
 #include "filters/functionfilters.h"
+#include "filters/pixelview.h"
+#include "filters/parallelexecutor.h"
+#include "filters/imagemetadata.h"
+#include "filters/hsvimage.h"
+#include <QAtomicInt>
+#include <QThread>
 #include <QColor>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// One tap of an error diffusion kernel
+template <typename T>
+struct DiffusionTap
+{
+    int x;
+    int y;
+    T weight;
+};
+
+// Accumulated error of the rows in flight, reused in slot y % rows. Rows
+// are padded by two columns on each side, so taps past the left and right
+// edges land in cells that are never read instead of needing a bounds check.
+template <typename T>
+class ErrorRows
+{
+public:
+    static const int Padding = 2;
+    
+    ErrorRows(int width, int rows)
+        : stride(width + 2 * Padding), rows(rows), data(static_cast<size_t>(stride) * rows) {}
+    
+    T *row(int y) {
+        return data.data() + static_cast<size_t>(y % rows) * stride + Padding;
+    }
+    
+    void clearRow(int y) {
+        T *first = row(y) - Padding;
+        std::fill(first, first + stride, T());
+    }
+    
+private:
+    int stride;
+    int rows;
+    std::vector<T> data;
+};
+
+// Pixels of a row finished so far, on its own cache line so neighbouring
+// rows do not contend for it
+struct alignas(64) RowProgress
+{
+    QAtomicInt done;
+};
+
+// Progress is published every this many pixels
+const int ProgressInterval = 32;
+
+int waitForProgress(const RowProgress &row, int target)
+{
+    int spins = 0;
+    int done;
+    while ((done = row.done.loadAcquire()) < target) {
+        if (++spins > 64) {
+            QThread::yieldCurrentThread();
+        }
+    }
+    return done;
+}
+
+inline void loadChannels(QRgb pixel, int *values)
+{
+    values[0] = qRed(pixel);
+    values[1] = qGreen(pixel);
+    values[2] = qBlue(pixel);
+}
+
+inline void loadChannels(uchar pixel, int *values)
+{
+    values[0] = pixel;
+}
+
+// A single channel is written to all three colour channels
+inline void storeChannels(QRgb &pixel, const int *values, int channels)
+{
+    pixel = channels == 1 ? qRgb(values[0], values[0], values[0])
+                          : qRgb(values[0], values[1], values[2]);
+}
+
+inline void storeChannels(uchar &pixel, const int *values, int)
+{
+    pixel = static_cast<uchar>(values[0]);
+}
+
+// Error diffusion over the first channels of every pixel of a PixelView or
+// GrayView. Errors accumulate
+// as T in units of scale.
+//
+// Rows run in parallel as a skewed wavefront: row y processes pixel x only
+// once row y - 1 has finished pixel x + 2 * reach. By then every error row
+// y - 1 adds to a cell that row y reads or adds to up to x is in place, so
+// each cell receives its additions in the same order as a serial scan and
+// the output is identical for any thread count. Rows also finish in order,
+// which bounds the error rows in flight to the threads plus the kernel rows.
+template <typename T, typename View>
+void diffuseErrors(View &image, int channels, const uchar quantized[3][256],
+                   const std::vector<DiffusionTap<T>> &taps, double scale)
+{
+    int width = image.width();
+    int height = image.height();
+    int tapCount = static_cast<int>(taps.size());
+    
+    int rows = 1;
+    int reach = 0;
+    for (const auto &tap : taps) {
+        rows = qMax(rows, tap.y + 1);
+        reach = qMax(reach, qAbs(tap.x));
+    }
+    int lag = 2 * reach + 1;
+    
+    int ring = ParallelExecutor::workerCount() + rows;
+    std::vector<ErrorRows<T>> errors(channels, ErrorRows<T>(width, ring));
+    std::unique_ptr<RowProgress[]> progress(new RowProgress[height]);
+    
+    ParallelExecutor::forEach(height, [&](int y) {
+        if (y > 0) {
+            // The slot was last used by a row that is finished by now;
+            // waiting on it also orders its reads before the clear
+            int previous = y + rows - 1 - ring;
+            if (previous >= 0) {
+                waitForProgress(progress[previous], width);
+            }
+            for (int c = 0; c < channels; ++c) {
+                errors[c].clearRow(y + rows - 1);
+            }
+        }
+        
+        T *current[3];
+        std::vector<T *> targets(static_cast<size_t>(channels) * tapCount);
+        for (int c = 0; c < channels; ++c) {
+            current[c] = errors[c].row(y);
+            for (int t = 0; t < tapCount; ++t) {
+                targets[c * tapCount + t] = errors[c].row(y + taps[t].y) + taps[t].x;
+            }
+        }
+        
+        int above = y > 0 ? 0 : width; // Pixels of row y - 1 known to be finished
+        auto *line = image.row(y);
+        for (int x = 0; x < width; ++x) {
+            int needed = qMin(width, x + lag);
+            if (above < needed) {
+                above = waitForProgress(progress[y - 1], needed);
+            }
+            
+            int values[3];
+            loadChannels(line[x], values);
+            
+            for (int c = 0; c < channels; ++c) {
+                // Apply accumulated error
+                int newValue = qBound(0, values[c] + qRound(current[c][x] * scale), 255);
+                values[c] = quantized[c][newValue];
+                
+                // Distribute the error according to the kernel
+                int error = newValue - values[c];
+                T *const *target = targets.data() + c * tapCount;
+                for (int t = 0; t < tapCount; ++t) {
+                    target[t][x] += error * taps[t].weight;
+                }
+            }
+            
+            storeChannels(line[x], values, channels);
+            
+            if ((x + 1) % ProgressInterval == 0) {
+                progress[y].done.storeRelease(x + 1);
+            }
+        }
+        progress[y].done.storeRelease(width);
+    });
+}
+
+} // namespace
+
+// Q_INIT_RESOURCE must not be called inside a namespace
+static void initDitheringResources() {
+    Q_INIT_RESOURCE(dithering);
+}
+
+// 64 x 64 blue-noise threshold tile (void-and-cluster), ranks 0..255
+static const QImage &blueNoiseTile() {
+    static const QImage tile = [] {
+        initDitheringResources();
+        return QImage(":/dithering/bluenoise64.pgm").convertToFormat(QImage::Format_Grayscale8);
+    }();
+    return tile;
+}
 
 // Base FunctionFilter implementation
 FunctionFilter::FunctionFilter(const QString &name) : name(name) {}
@@ -11,34 +207,90 @@ QString FunctionFilter::getName() const {
     return name;
 }
 
-QRgb FunctionFilter::applyToPixel(QRgb pixel, std::function<int(int)> func) {
-    int r = qRed(pixel);
-    int g = qGreen(pixel);
-    int b = qBlue(pixel);
+bool FunctionFilter::isPointOperation() const {
+    return false;
+}
+
+LookupTable FunctionFilter::buildLookupTable() const {
+    // Identity curve for filters that are not point operations
+    LookupTable lut;
+    for (int value = 0; value < 256; ++value) {
+        lut.red[value] = lut.green[value] = lut.blue[value] = static_cast<uchar>(value);
+    }
+    return lut;
+}
+
+void FunctionFilter::fillChannel(uchar *table, const std::function<int(int)> &func) {
+    for (int value = 0; value < 256; ++value) {
+        table[value] = static_cast<uchar>(qBound(0, func(value), 255));
+    }
+}
+
+void FunctionFilter::fillChannels(LookupTable &lut, const std::function<int(int)> &func) {
+    fillChannel(lut.red, func);
+    memcpy(lut.green, lut.red, sizeof(lut.red));
+    memcpy(lut.blue, lut.red, sizeof(lut.red));
+}
+
+QImage FunctionFilter::applyLookupTable(const QImage &image, const LookupTable &lut) {
+    // The same table on every channel keeps gray pixels gray
+    bool sameCurve = memcmp(lut.red, lut.green, sizeof(lut.red)) == 0 &&
+                     memcmp(lut.red, lut.blue, sizeof(lut.red)) == 0;
+    
+    if (sameCurve && GrayView::isGrayFormat(image)) {
+        ConstGrayView src(image);
+        QImage result = GrayView::createResult(src);
+        GrayView dst(result);
+        for (int y = 0; y < src.height(); ++y) {
+            const uchar *in = src.row(y);
+            uchar *out = dst.row(y);
+            for (int x = 0; x < src.width(); ++x) {
+                out[x] = lut.red[in[x]];
+            }
+        }
+        return result;
+    }
     
-    r = qBound(0, func(r), 255);
-    g = qBound(0, func(g), 255);
-    b = qBound(0, func(b), 255);
+    ConstPixelView src(image);
+    QImage result = PixelView::createResult(src);
+    PixelView dst(result);
     
-    return qRgba(r, g, b, qAlpha(pixel));
+    for (int y = 0; y < src.height(); ++y) {
+        const QRgb *in = src.row(y);
+        QRgb *out = dst.row(y);
+        for (int x = 0; x < src.width(); ++x) {
+            QRgb pixel = in[x];
+            out[x] = (pixel & 0xff000000)
+                   | (static_cast<QRgb>(lut.red[qRed(pixel)]) << 16)
+                   | (static_cast<QRgb>(lut.green[qGreen(pixel)]) << 8)
+                   | static_cast<QRgb>(lut.blue[qBlue(pixel)]);
+        }
+    }
+    
+    if (sameCurve) {
+        ImageMetadata::copyGrayscale(image, result);
+    }
+    
+    return result;
 }
 
 // InversionFilter implementation
 InversionFilter::InversionFilter() : FunctionFilter("Inversion") {}
 
 QImage InversionFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            result.setPixel(x, y, applyToPixel(pixel, [](int value) {
-                return 255 - value;
-            }));
-        }
-    }
-    
-    return result;
+    return applyLookupTable(image, buildLookupTable());
+}
+
+bool InversionFilter::isPointOperation() const {
+    return true;
+}
+
+LookupTable InversionFilter::buildLookupTable() const {
+    LookupTable lut;
+    fillChannels(lut, [](int value) {
+        return 255 - value;
+    });
+    return lut;
 }
 
 // BrightnessFilter implementation
@@ -46,18 +298,19 @@ BrightnessFilter::BrightnessFilter(double factor)
     : FunctionFilter("Brightness"), factor(factor) {}
 
 QImage BrightnessFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            result.setPixel(x, y, applyToPixel(pixel, [this](int value) {
-                return value + static_cast<int>(factor);
-            }));
-        }
-    }
-    
-    return result;
+    return applyLookupTable(image, buildLookupTable());
+}
+
+bool BrightnessFilter::isPointOperation() const {
+    return true;
+}
+
+LookupTable BrightnessFilter::buildLookupTable() const {
+    LookupTable lut;
+    fillChannels(lut, [this](int value) {
+        return value + static_cast<int>(factor);
+    });
+    return lut;
 }
 
 void BrightnessFilter::setFactor(double factor) {
@@ -73,18 +326,19 @@ ContrastFilter::ContrastFilter(double factor)
     : FunctionFilter("Contrast"), factor(factor) {}
 
 QImage ContrastFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            result.setPixel(x, y, applyToPixel(pixel, [this](int value) {
-                return static_cast<int>((value - 128) * factor + 128);
-            }));
-        }
-    }
-    
-    return result;
+    return applyLookupTable(image, buildLookupTable());
+}
+
+bool ContrastFilter::isPointOperation() const {
+    return true;
+}
+
+LookupTable ContrastFilter::buildLookupTable() const {
+    LookupTable lut;
+    fillChannels(lut, [this](int value) {
+        return static_cast<int>((value - 128) * factor + 128);
+    });
+    return lut;
 }
 
 void ContrastFilter::setFactor(double factor) {
@@ -100,18 +354,19 @@ GammaFilter::GammaFilter(double gamma)
     : FunctionFilter("Gamma"), gamma(gamma) {}
 
 QImage GammaFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            result.setPixel(x, y, applyToPixel(pixel, [this](int value) {
-                return static_cast<int>(255.0 * pow(value / 255.0, 1.0 / gamma));
-            }));
-        }
-    }
-    
-    return result;
+    return applyLookupTable(image, buildLookupTable());
+}
+
+bool GammaFilter::isPointOperation() const {
+    return true;
+}
+
+LookupTable GammaFilter::buildLookupTable() const {
+    LookupTable lut;
+    fillChannels(lut, [this](int value) {
+        return static_cast<int>(255.0 * pow(value / 255.0, 1.0 / gamma));
+    });
+    return lut;
 }
 
 void GammaFilter::setGamma(double gamma) {
@@ -122,27 +377,100 @@ double GammaFilter::getGamma() const {
     return gamma;
 }
 
+// PointFilterChain implementation
+PointFilterChain::PointFilterChain()
+    : FunctionFilter("Point Filter Chain"), lut(FunctionFilter::buildLookupTable()), count(0) {}
+
+QImage PointFilterChain::apply(const QImage &image) {
+    return applyLookupTable(image, lut);
+}
+
+bool PointFilterChain::isPointOperation() const {
+    return true;
+}
+
+LookupTable PointFilterChain::buildLookupTable() const {
+    return lut;
+}
+
+bool PointFilterChain::append(const FunctionFilter &filter) {
+    if (!filter.isPointOperation()) {
+        return false;
+    }
+    
+    // Every table is already clamped to 0..255, so feeding one curve into the
+    // next gives exactly what running the filters one after another would
+    LookupTable next = filter.buildLookupTable();
+    for (int value = 0; value < 256; ++value) {
+        lut.red[value] = next.red[lut.red[value]];
+        lut.green[value] = next.green[lut.green[value]];
+        lut.blue[value] = next.blue[lut.blue[value]];
+    }
+    ++count;
+    
+    return true;
+}
+
+int PointFilterChain::size() const {
+    return count;
+}
+
+void PointFilterChain::clear() {
+    lut = FunctionFilter::buildLookupTable();
+    count = 0;
+}
+
 // GrayscaleFilter implementation
 GrayscaleFilter::GrayscaleFilter() : FunctionFilter("Grayscale") {}
 
 QImage GrayscaleFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            int r = qRed(pixel);
-            int g = qGreen(pixel);
-            int b = qBlue(pixel);
-            
-            // Standard grayscale conversion formula (ITU-R BT.601)
-            int gray = qRound(0.299 * r + 0.587 * g + 0.114 * b);
-            gray = qBound(0, gray, 255);
-            
-            result.setPixel(x, y, qRgba(gray, gray, gray, qAlpha(pixel)));
+    // The formula maps gray values to themselves
+    if (GrayView::isGrayFormat(image)) {
+        ConstGrayView src(image);
+        QImage result = GrayView::createResult(src);
+        GrayView dst(result);
+        for (int y = 0; y < src.height(); ++y) {
+            std::memcpy(dst.row(y), src.row(y), src.width());
         }
+        return result;
     }
     
+    ConstPixelView src(image);
+    
+    // Standard grayscale conversion formula (ITU-R BT.601)
+    auto toGray = [](QRgb pixel) {
+        int gray = qRound(0.299 * qRed(pixel) + 0.587 * qGreen(pixel) + 0.114 * qBlue(pixel));
+        return qBound(0, gray, 255);
+    };
+    
+    // Without alpha to keep, the result switches to one channel per pixel,
+    // which the filters after it process at a third of the cost
+    if (!src.image().hasAlphaChannel()) {
+        QImage result = GrayView::createResult(src);
+        GrayView dst(result);
+        for (int y = 0; y < src.height(); ++y) {
+            const QRgb *in = src.row(y);
+            uchar *out = dst.row(y);
+            for (int x = 0; x < src.width(); ++x) {
+                out[x] = static_cast<uchar>(toGray(in[x]));
+            }
+        }
+        return result;
+    }
+    
+    QImage result = PixelView::createResult(src);
+    PixelView dst(result);
+    
+    for (int y = 0; y < src.height(); ++y) {
+        const QRgb *in = src.row(y);
+        QRgb *out = dst.row(y);
+        for (int x = 0; x < src.width(); ++x) {
+            int gray = toGray(in[x]);
+            out[x] = qRgba(gray, gray, gray, qAlpha(in[x]));
+        }
+    }
+    
+    ImageMetadata::setGrayscale(result, true);
     return result;
 }
 
@@ -151,47 +479,30 @@ UniformQuantizationFilter::UniformQuantizationFilter(int rLevels, int gLevels, i
     : FunctionFilter("Uniform Quantization"), rLevels(rLevels), gLevels(gLevels), bLevels(bLevels) {}
 
 QImage UniformQuantizationFilter::apply(const QImage &image) {
-    QImage result = image.copy();
-    
-    // Calculate the size of each level/step for each color channel
-    double rStep = 256.0 / rLevels;
-    double gStep = 256.0 / gLevels;
-    double bStep = 256.0 / bLevels;
+    return applyLookupTable(image, buildLookupTable());
+}
+
+bool UniformQuantizationFilter::isPointOperation() const {
+    return true;
+}
+
+LookupTable UniformQuantizationFilter::buildLookupTable() const {
+    LookupTable lut;
+    fillChannel(lut.red, [this](int value) { return quantizeChannel(value, rLevels); });
+    fillChannel(lut.green, [this](int value) { return quantizeChannel(value, gLevels); });
+    fillChannel(lut.blue, [this](int value) { return quantizeChannel(value, bLevels); });
+    return lut;
+}
+
+int UniformQuantizationFilter::quantizeChannel(int value, int levels) {
+    // Calculate the size of each level/step
+    double step = 256.0 / levels;
     
-    for (int y = 0; y < result.height(); ++y) {
-        for (int x = 0; x < result.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            
-            int r = qRed(pixel);
-            int g = qGreen(pixel);
-            int b = qBlue(pixel);
-            
-            // Quantize each color channel
-            // First determine which level the color falls into
-            int rLevel = static_cast<int>(r / rStep);
-            int gLevel = static_cast<int>(g / gStep);
-            int bLevel = static_cast<int>(b / bStep);
-            
-            // Ensure we don't exceed the maximum level
-            rLevel = qMin(rLevel, rLevels - 1);
-            gLevel = qMin(gLevel, gLevels - 1);
-            bLevel = qMin(bLevel, bLevels - 1);
-            
-            // Map the level back to a color value (center of the level's range)
-            r = static_cast<int>((rLevel + 0.5) * rStep);
-            g = static_cast<int>((gLevel + 0.5) * gStep);
-            b = static_cast<int>((bLevel + 0.5) * bStep);
-            
-            // Ensure the values are within valid range
-            r = qBound(0, r, 255);
-            g = qBound(0, g, 255);
-            b = qBound(0, b, 255);
-            
-            result.setPixel(x, y, qRgba(r, g, b, qAlpha(pixel)));
-        }
-    }
+    // Determine which level the value falls into, without exceeding the maximum level
+    int level = qMin(static_cast<int>(value / step), levels - 1);
     
-    return result;
+    // Map the level back to a color value (center of the level's range)
+    return static_cast<int>((level + 0.5) * step);
 }
 
 void UniformQuantizationFilter::setLevels(int rLevels, int gLevels, int bLevels) {
@@ -217,20 +528,8 @@ DitheringFilter::DitheringFilter(int rLevels, int gLevels, int bLevels, KernelTy
     : FunctionFilter("Dithering"), rLevels(rLevels), gLevels(gLevels), bLevels(bLevels), kernelType(kernelType) {}
 
 QImage DitheringFilter::apply(const QImage &image) {
-    // Detect if the image is grayscale
-    bool isGrayscale = true;
-    for (int y = 0; y < image.height() && isGrayscale; ++y) {
-        for (int x = 0; x < image.width() && isGrayscale; ++x) {
-            QRgb pixel = image.pixel(x, y);
-            if (qRed(pixel) != qGreen(pixel) || qRed(pixel) != qBlue(pixel)) {
-                isGrayscale = false;
-                break;
-            }
-        }
-    }
-    
     // Apply appropriate dithering based on image type
-    if (isGrayscale) {
+    if (ImageMetadata::isGrayscale(image)) {
         return applyToGrayscale(image);
     } else {
         return applyToColor(image);
@@ -269,10 +568,19 @@ QStringList DitheringFilter::getKernelNames() {
         "Burkes",
         "Stucki",
         "Sierra",
-        "Atkinson"
+        "Atkinson",
+        "Bayer 2x2",
+        "Bayer 4x4",
+        "Bayer 8x8",
+        "Bayer 16x16",
+        "Blue Noise"
     };
 }
 
+bool DitheringFilter::isErrorDiffusion(KernelType kernelType) {
+    return kernelType < BAYER_2X2;
+}
+
 int DitheringFilter::quantizeValue(int value, int levels) {
     if (levels <= 1) return 0;
     
@@ -287,112 +595,177 @@ int DitheringFilter::quantizeValue(int value, int levels) {
 }
 
 QImage DitheringFilter::applyToGrayscale(const QImage &image) {
-    // Create a copy of the image
-    QImage result = image.convertToFormat(QImage::Format_RGB32);
+    // Using rLevels for grayscale
+    QImage result = isErrorDiffusion(kernelType) ? diffuse(image, 1) : applyThreshold(image, 1);
+    ImageMetadata::setGrayscale(result, true);
+    return result;
+}
+
+QImage DitheringFilter::applyToColor(const QImage &image) {
+    return isErrorDiffusion(kernelType) ? diffuse(image, 3) : applyThreshold(image, 3);
+}
+
+QImage DitheringFilter::diffuse(const QImage &image, int channels) {
+    // Create a copy of the image; gray images stay single-channel
+    bool gray = channels == 1 && GrayView::isGrayFormat(image);
+    QImage result = gray ? GrayView::normalize(image) : image.convertToFormat(QImage::Format_RGB32);
     
-    // Create error buffer with some extra space on borders to simplify algorithm
-    int width = result.width();
-    int height = result.height();
-    QVector<QVector<double>> errors(height + 2, QVector<double>(width + 2, 0.0));
+    uchar quantized[3][256];
+    int levels[3] = { rLevels, gLevels, bLevels };
+    for (int c = 0; c < 3; ++c) {
+        for (int value = 0; value < 256; ++value) {
+            quantized[c][value] = quantizeValue(value, levels[c]);
+        }
+    }
     
-    // Get diffusion kernel
-    QVector<DiffusionCoefficient> kernel = getDiffusionKernel();
+    int divisor = 1;
+    QVector<DiffusionCoefficient> kernel = getDiffusionKernel(divisor);
     
-    // Process the image
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            QRgb pixel = result.pixel(x, y);
-            int oldValue = qRed(pixel);  // For grayscale, all R,G,B are the same
-            
-            // Apply accumulated error
-            int newValue = qBound(0, oldValue + qRound(errors[y][x]), 255);
-            
-            // Quantize the value
-            int quantizedValue = quantizeValue(newValue, rLevels);  // Using rLevels for grayscale
-            
-            // Set the new pixel value
-            result.setPixel(x, y, qRgb(quantizedValue, quantizedValue, quantizedValue));
-            
-            // Calculate the error
-            int error = newValue - quantizedValue;
-            
-            // Distribute the error according to the kernel
+    // With a power-of-two divisor every accumulated error is an exact binary
+    // fraction, so integer numerators reproduce the double sums exactly.
+    // Other divisors (Stucki's 42) keep double sums added in the same order.
+    auto run = [&](auto &dst) {
+        if ((divisor & (divisor - 1)) == 0) {
+            std::vector<DiffusionTap<int>> taps;
             for (const auto &coeff : kernel) {
-                int newX = x + coeff.x;
-                int newY = y + coeff.y;
-                
-                // Make sure we're within bounds
-                if (newX >= 0 && newX < width && newY >= 0 && newY < height) {
-                    errors[newY][newX] += error * coeff.weight;
-                }
+                taps.push_back({ coeff.x, coeff.y, coeff.weight });
+            }
+            diffuseErrors(dst, channels, quantized, taps, 1.0 / divisor);
+        } else {
+            std::vector<DiffusionTap<double>> taps;
+            for (const auto &coeff : kernel) {
+                taps.push_back({ coeff.x, coeff.y, static_cast<double>(coeff.weight) / divisor });
             }
+            diffuseErrors(dst, channels, quantized, taps, 1.0);
         }
+    };
+    
+    if (gray) {
+        GrayView dst(result);
+        run(dst);
+    } else {
+        PixelView dst(result);
+        run(dst);
     }
     
     return result;
 }
 
-QImage DitheringFilter::applyToColor(const QImage &image) {
-    // Create a copy of the image
-    QImage result = image.convertToFormat(QImage::Format_RGB32);
+QImage DitheringFilter::applyThreshold(const QImage &image, int channels) {
+    // Create a copy of the image; gray images stay single-channel
+    bool gray = channels == 1 && GrayView::isGrayFormat(image);
+    QImage result = gray ? GrayView::normalize(image) : image.convertToFormat(QImage::Format_RGB32);
     
-    // Create error buffers for each channel
-    int width = result.width();
-    int height = result.height();
-    QVector<QVector<double>> errorsR(height + 2, QVector<double>(width + 2, 0.0));
-    QVector<QVector<double>> errorsG(height + 2, QVector<double>(width + 2, 0.0));
-    QVector<QVector<double>> errorsB(height + 2, QVector<double>(width + 2, 0.0));
+    int side = 1;
+    int ranks = 1;
+    QVector<int> matrix = getThresholdMatrix(kernelType, side, ranks);
     
-    // Get diffusion kernel
-    QVector<DiffusionCoefficient> kernel = getDiffusionKernel();
+    // With p = value * (levels - 1), a value lies p / 255 levels up plus a
+    // remainder of p % 255. Rank r adds a threshold of (r + 0.5) / ranks, so
+    // the value rounds up to the next level once the remainder reaches
+    // ceil(255 * (2 * ranks - 2 * r - 1) / (2 * ranks)).
+    QVector<uchar> minimumRemainder(side * side);
+    for (int i = 0; i < side * side; ++i) {
+        int numerator = 255 * (2 * ranks - 2 * matrix[i] - 1);
+        minimumRemainder[i] = static_cast<uchar>((numerator + 2 * ranks - 1) / (2 * ranks));
+    }
     
-    // Process the image
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            QRgb pixel = result.pixel(x, y);
-            
-            // Get original color values
-            int oldR = qRed(pixel);
-            int oldG = qGreen(pixel);
-            int oldB = qBlue(pixel);
-            
-            // Apply accumulated errors
-            int newR = qBound(0, oldR + qRound(errorsR[y][x]), 255);
-            int newG = qBound(0, oldG + qRound(errorsG[y][x]), 255);
-            int newB = qBound(0, oldB + qRound(errorsB[y][x]), 255);
-            
-            // Quantize each channel
-            int quantizedR = quantizeValue(newR, rLevels);
-            int quantizedG = quantizeValue(newG, gLevels);
-            int quantizedB = quantizeValue(newB, bLevels);
-            
-            // Set the new pixel value
-            result.setPixel(x, y, qRgb(quantizedR, quantizedG, quantizedB));
-            
-            // Calculate the errors
-            int errorR = newR - quantizedR;
-            int errorG = newG - quantizedG;
-            int errorB = newB - quantizedB;
-            
-            // Distribute the errors according to the kernel
-            for (const auto &coeff : kernel) {
-                int newX = x + coeff.x;
-                int newY = y + coeff.y;
+    int levels[3] = { rLevels, channels == 1 ? rLevels : gLevels, channels == 1 ? rLevels : bLevels };
+    int steps[3];
+    uchar levelValues[3][256];
+    for (int c = 0; c < 3; ++c) {
+        steps[c] = qBound(0, levels[c] - 1, 255);
+        double step = steps[c] > 0 ? 255.0 / steps[c] : 0.0;
+        for (int level = 0; level < 256; ++level) {
+            levelValues[c][level] = qBound(0, static_cast<int>(level * step), 255);
+        }
+    }
+    
+    auto quantize = [](int value, int steps, int minimum, const uchar *values) {
+        int p = value * steps;
+        int level = (p + 1 + (p >> 8)) >> 8; // p / 255 for p < 65535
+        int remainder = p - 255 * level;
+        return values[level + (remainder >= minimum ? 1 : 0)];
+    };
+    
+    int width = result.width();
+    auto run = [&](auto &dst) {
+        ParallelExecutor::forEachRowBand(result.height(), [&](int firstRow, int endRow) {
+            std::vector<uchar> thresholds(width);
+            for (int y = firstRow; y < endRow; ++y) {
+                const uchar *tileRow = minimumRemainder.constData() + (y % side) * side;
+                for (int x = 0; x < width; ++x) {
+                    thresholds[x] = tileRow[x % side];
+                }
                 
-                // Make sure we're within bounds
-                if (newX >= 0 && newX < width && newY >= 0 && newY < height) {
-                    errorsR[newY][newX] += errorR * coeff.weight;
-                    errorsG[newY][newX] += errorG * coeff.weight;
-                    errorsB[newY][newX] += errorB * coeff.weight;
+                auto *line = dst.row(y);
+                for (int x = 0; x < width; ++x) {
+                    int values[3];
+                    loadChannels(line[x], values);
+                    for (int c = 0; c < channels; ++c) {
+                        values[c] = quantize(values[c], steps[c], thresholds[x], levelValues[c]);
+                    }
+                    storeChannels(line[x], values, channels);
                 }
             }
-        }
+        });
+    };
+    
+    if (gray) {
+        GrayView dst(result);
+        run(dst);
+    } else {
+        PixelView dst(result);
+        run(dst);
     }
     
     return result;
 }
 
-QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKernel() {
+QVector<int> DitheringFilter::getThresholdMatrix(KernelType kernelType, int &side, int &ranks) {
+    if (kernelType == BLUE_NOISE) {
+        const QImage &tile = blueNoiseTile();
+        if (!tile.isNull() && tile.width() == tile.height()) {
+            side = tile.width();
+            ranks = 256;
+            QVector<int> matrix(side * side);
+            for (int y = 0; y < side; ++y) {
+                const uchar *line = tile.constScanLine(y);
+                for (int x = 0; x < side; ++x) {
+                    matrix[y * side + x] = line[x];
+                }
+            }
+            return matrix;
+        }
+        
+        // Resource missing: fall back to the largest Bayer matrix
+        kernelType = BAYER_16X16;
+    }
+    
+    // Bayer matrices grow recursively: M(2n) = [4M, 4M + 2; 4M + 3, 4M + 1]
+    int target = 2 << (kernelType - BAYER_2X2);
+    QVector<int> matrix(1, 0);
+    side = 1;
+    while (side < target) {
+        int next = 2 * side;
+        QVector<int> grown(next * next);
+        for (int y = 0; y < side; ++y) {
+            for (int x = 0; x < side; ++x) {
+                int value = 4 * matrix[y * side + x];
+                grown[y * next + x] = value;
+                grown[y * next + x + side] = value + 2;
+                grown[(y + side) * next + x] = value + 3;
+                grown[(y + side) * next + x + side] = value + 1;
+            }
+        }
+        matrix = grown;
+        side = next;
+    }
+    ranks = side * side;
+    return matrix;
+}
+
+QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKernel(int &divisor) {
     QVector<DiffusionCoefficient> kernel;
     
     switch (kernelType) {
@@ -401,11 +774,12 @@ QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKern
             //     *  7/16
             // 3/16 5/16 1/16
             kernel = {
-                {1, 0, 7.0/16.0},
-                {-1, 1, 3.0/16.0},
-                {0, 1, 5.0/16.0},
-                {1, 1, 1.0/16.0}
+                {1, 0, 7},
+                {-1, 1, 3},
+                {0, 1, 5},
+                {1, 1, 1}
             };
+            divisor = 16;
             break;
             
         case BURKES:
@@ -413,14 +787,15 @@ QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKern
             //       *  8/32  4/32
             // 2/32 4/32 8/32 4/32 2/32
             kernel = {
-                {1, 0, 8.0/32.0},
-                {2, 0, 4.0/32.0},
-                {-2, 1, 2.0/32.0},
-                {-1, 1, 4.0/32.0},
-                {0, 1, 8.0/32.0},
-                {1, 1, 4.0/32.0},
-                {2, 1, 2.0/32.0}
+                {1, 0, 8},
+                {2, 0, 4},
+                {-2, 1, 2},
+                {-1, 1, 4},
+                {0, 1, 8},
+                {1, 1, 4},
+                {2, 1, 2}
             };
+            divisor = 32;
             break;
             
         case STUCKI:
@@ -429,19 +804,20 @@ QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKern
             // 2/42 4/42 8/42  4/42  2/42
             // 1/42 2/42 4/42  2/42  1/42
             kernel = {
-                {1, 0, 8.0/42.0},
-                {2, 0, 4.0/42.0},
-                {-2, 1, 2.0/42.0},
-                {-1, 1, 4.0/42.0},
-                {0, 1, 8.0/42.0},
-                {1, 1, 4.0/42.0},
-                {2, 1, 2.0/42.0},
-                {-2, 2, 1.0/42.0},
-                {-1, 2, 2.0/42.0},
-                {0, 2, 4.0/42.0},
-                {1, 2, 2.0/42.0},
-                {2, 2, 1.0/42.0}
+                {1, 0, 8},
+                {2, 0, 4},
+                {-2, 1, 2},
+                {-1, 1, 4},
+                {0, 1, 8},
+                {1, 1, 4},
+                {2, 1, 2},
+                {-2, 2, 1},
+                {-1, 2, 2},
+                {0, 2, 4},
+                {1, 2, 2},
+                {2, 2, 1}
             };
+            divisor = 42;
             break;
             
         case SIERRA:
@@ -450,17 +826,18 @@ QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKern
             // 2/32 4/32 5/32  4/32  2/32
             //       2/32 3/32  2/32
             kernel = {
-                {1, 0, 5.0/32.0},
-                {2, 0, 3.0/32.0},
-                {-2, 1, 2.0/32.0},
-                {-1, 1, 4.0/32.0},
-                {0, 1, 5.0/32.0},
-                {1, 1, 4.0/32.0},
-                {2, 1, 2.0/32.0},
-                {-1, 2, 2.0/32.0},
-                {0, 2, 3.0/32.0},
-                {1, 2, 2.0/32.0}
+                {1, 0, 5},
+                {2, 0, 3},
+                {-2, 1, 2},
+                {-1, 1, 4},
+                {0, 1, 5},
+                {1, 1, 4},
+                {2, 1, 2},
+                {-1, 2, 2},
+                {0, 2, 3},
+                {1, 2, 2}
             };
+            divisor = 32;
             break;
             
         case ATKINSON:
@@ -469,15 +846,83 @@ QVector<DitheringFilter::DiffusionCoefficient> DitheringFilter::getDiffusionKern
             // 1/8 1/8 1/8
             //      1/8
             kernel = {
-                {1, 0, 1.0/8.0},
-                {2, 0, 1.0/8.0},
-                {-1, 1, 1.0/8.0},
-                {0, 1, 1.0/8.0},
-                {1, 1, 1.0/8.0},
-                {0, 2, 1.0/8.0}
+                {1, 0, 1},
+                {2, 0, 1},
+                {-1, 1, 1},
+                {0, 1, 1},
+                {1, 1, 1},
+                {0, 2, 1}
             };
+            divisor = 8;
+            break;
+            
+        default:
             break;
     }
     
     return kernel;
-} 
\ No newline at end of file
+} 
+
+// HueRotationFilter implementation
+HueRotationFilter::HueRotationFilter(double degrees)
+    : FunctionFilter("Hue Rotation"), degrees(degrees) {}
+
+QImage HueRotationFilter::apply(const QImage &image) {
+    HsvAdjustment adjustment;
+    adjustment.hueShift = degrees;
+    return HsvImage::adjust(image, adjustment);
+}
+
+void HueRotationFilter::setDegrees(double degrees) {
+    this->degrees = degrees;
+}
+
+double HueRotationFilter::getDegrees() const {
+    return degrees;
+}
+
+// SaturationFilter implementation
+SaturationFilter::SaturationFilter(double gain)
+    : FunctionFilter("Saturation"), gain(gain) {}
+
+QImage SaturationFilter::apply(const QImage &image) {
+    HsvAdjustment adjustment;
+    adjustment.saturationGain = gain;
+    return HsvImage::adjust(image, adjustment);
+}
+
+void SaturationFilter::setGain(double gain) {
+    this->gain = qMax(0.0, gain);
+}
+
+double SaturationFilter::getGain() const {
+    return gain;
+}
+
+// ValueFilter implementation
+ValueFilter::ValueFilter(double gain, double gamma)
+    : FunctionFilter("Value"), gain(gain), gamma(gamma) {}
+
+QImage ValueFilter::apply(const QImage &image) {
+    HsvAdjustment adjustment;
+    fillChannel(adjustment.value, [this](int value) {
+        return qRound(255.0 * gain * pow(value / 255.0, 1.0 / gamma));
+    });
+    return HsvImage::adjust(image, adjustment);
+}
+
+void ValueFilter::setGain(double gain) {
+    this->gain = qMax(0.0, gain);
+}
+
+double ValueFilter::getGain() const {
+    return gain;
+}
+
+void ValueFilter::setGamma(double gamma) {
+    this->gamma = gamma;
+}
+
+double ValueFilter::getGamma() const {
+    return gamma;
+}
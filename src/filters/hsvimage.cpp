@@ -0,0 +1,313 @@
+#include "filters/hsvimage.h"
+#include "filters/pixelview.h"
+#include "filters/parallelexecutor.h"
+#include "filters/imagemetadata.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Pixels converted per block. Lane loops have this fixed trip count and no
+// branches, so the compiler turns them into vector min/max, compares and
+// blends.
+static const int HsvLanes = 16;
+
+// RGB to HSV for one block. Hue and saturation are exact floors of their
+// rational values: a float quotient of two exact integers this small is
+// never within rounding error of the next integer.
+static inline void rgbToHsvLanes(const QRgb *in, uchar *hue, uchar *saturation, uchar *value) {
+    for (int i = 0; i < HsvLanes; ++i) {
+        int r = (in[i] >> 16) & 0xff;
+        int g = (in[i] >> 8) & 0xff;
+        int b = in[i] & 0xff;
+        
+        int maximum = std::max(std::max(r, g), b);
+        int minimum = std::min(std::min(r, g), b);
+        int delta = maximum - minimum;
+        
+        // Hue in sixths of the circle, times delta. Every candidate is
+        // computed so the selection is a blend, not a branch. Gray pixels
+        // come out as 0.
+        int wrap = g < b ? 6 * delta : 0;
+        int fromRed = g - b + wrap;
+        int fromGreen = b - r + 2 * delta;
+        int fromBlue = r - g + 4 * delta;
+        int sector = maximum == r ? fromRed : (maximum == g ? fromGreen : fromBlue);
+        
+        float h = static_cast<float>(sector * 255) / static_cast<float>(6 * std::max(delta, 1));
+        float s = static_cast<float>(delta * 255) / static_cast<float>(maximum + (maximum == 0));
+        
+        hue[i] = static_cast<uchar>(static_cast<int>(h));
+        saturation[i] = static_cast<uchar>(static_cast<int>(s));
+        value[i] = static_cast<uchar>(maximum);
+    }
+}
+
+// HSV to RGB for one block. Channel n of (R, G, B) = (5, 3, 1) is
+// V - C * clamp(min(k, 4 - k), 0, 1) with k = (n + H / 60) mod 6, which
+// needs no per-sector branches. k and the clamp run in 1/255 steps of a
+// sixth; V * S * t is exact in float. Results round to the nearest level.
+static inline void hsvToRgbLanes(const uchar *hue, const uchar *saturation, const uchar *value, QRgb *out) {
+    static const int offsets[3] = { 5 * 255, 3 * 255, 255 };
+    for (int i = 0; i < HsvLanes; ++i) {
+        int h = hue[i] * 6;
+        int v = value[i];
+        int chroma = v * saturation[i];
+        
+        QRgb pixel = 0xff000000u;
+        for (int c = 0; c < 3; ++c) {
+            int k = offsets[c] + h;
+            k = k >= 6 * 255 ? k - 6 * 255 : k;
+            int t = std::min(std::max(std::min(k, 4 * 255 - k), 0), 255);
+            float level = static_cast<float>(v * 65025 - chroma * t) * (1.0f / 65025.0f);
+            pixel |= static_cast<QRgb>(static_cast<int>(level + 0.5f)) << (16 - 8 * c);
+        }
+        out[i] = pixel;
+    }
+}
+
+// Fixed-point unit of the fused adjustment: hue in sixths of the circle and
+// saturation run in 1/65536 steps
+static const int AdjustOne = 1 << 16;
+
+// Largest saturation gain; keeps the scaled saturation within an int
+static const double MaximumSaturationGain = 256.0;
+
+// RGB to HSV, adjustment and HSV to RGB for one block, keeping alpha. The
+// conversions are those of rgbToHsvLanes() and hsvToRgbLanes() without the
+// 8-bit rounding in between. Hue plus a shift in [0, 6) lies in [0, 12), so
+// k lies in [0, 18) and the clamp takes the largest of its three periods
+// instead of wrapping. Only the value curve lookup is scalar; it runs as a
+// loop of its own between the two vector loops.
+static inline void adjustLanes(const QRgb *in, QRgb *out, int hueShift, float saturationGain,
+                               const uchar *valueCurve) {
+    int hue[HsvLanes];
+    int saturation[HsvLanes];
+    int value[HsvLanes];
+    
+    for (int i = 0; i < HsvLanes; ++i) {
+        int r = (in[i] >> 16) & 0xff;
+        int g = (in[i] >> 8) & 0xff;
+        int b = in[i] & 0xff;
+        
+        int maximum = std::max(std::max(r, g), b);
+        int minimum = std::min(std::min(r, g), b);
+        int delta = maximum - minimum;
+        
+        int wrap = g < b ? 6 * delta : 0;
+        int fromRed = g - b + wrap;
+        int fromGreen = b - r + 2 * delta;
+        int fromBlue = r - g + 4 * delta;
+        int sector = maximum == r ? fromRed : (maximum == g ? fromGreen : fromBlue);
+        
+        float h = static_cast<float>(sector) * AdjustOne / static_cast<float>(std::max(delta, 1)) + 0.5f;
+        float s = static_cast<float>(delta) * saturationGain / static_cast<float>(maximum + (maximum == 0)) + 0.5f;
+        
+        hue[i] = static_cast<int>(h) + hueShift;
+        saturation[i] = std::min(static_cast<int>(s), AdjustOne);
+        value[i] = maximum;
+    }
+    
+    for (int i = 0; i < HsvLanes; ++i) {
+        value[i] = valueCurve[value[i]];
+    }
+    
+    static const int offsets[3] = { 5 * AdjustOne, 3 * AdjustOne, AdjustOne };
+    for (int i = 0; i < HsvLanes; ++i) {
+        float v = static_cast<float>(value[i]);
+        float chroma = v * static_cast<float>(saturation[i]) * (1.0f / AdjustOne);
+        
+        QRgb pixel = in[i] & 0xff000000u;
+        for (int c = 0; c < 3; ++c) {
+            int k = offsets[c] + hue[i];
+            int t = std::max(std::max(std::min(k, 4 * AdjustOne - k),
+                                      std::min(k - 6 * AdjustOne, 10 * AdjustOne - k)),
+                             std::min(k - 12 * AdjustOne, 16 * AdjustOne - k));
+            t = std::min(std::max(t, 0), AdjustOne);
+            float level = v - chroma * static_cast<float>(t) * (1.0f / AdjustOne);
+            pixel |= static_cast<QRgb>(static_cast<int>(level + 0.5f)) << (16 - 8 * c);
+        }
+        out[i] = pixel;
+    }
+}
+
+HsvAdjustment::HsvAdjustment() : hueShift(0.0), saturationGain(1.0) {
+    for (int v = 0; v < 256; ++v) {
+        value[v] = static_cast<uchar>(v);
+    }
+}
+
+HsvImage::HsvImage() {}
+
+HsvImage::HsvImage(int width, int height) {
+    for (QImage &plane : planes) {
+        plane = QImage(width, height, QImage::Format_Grayscale8);
+    }
+}
+
+bool HsvImage::isNull() const {
+    return planes[Hue].isNull();
+}
+
+int HsvImage::width() const {
+    return planes[Hue].width();
+}
+
+int HsvImage::height() const {
+    return planes[Hue].height();
+}
+
+QSize HsvImage::size() const {
+    return planes[Hue].size();
+}
+
+const uchar *HsvImage::row(Channel channel, int y) const {
+    return planes[channel].constScanLine(y);
+}
+
+uchar *HsvImage::row(Channel channel, int y) {
+    return planes[channel].scanLine(y);
+}
+
+QImage HsvImage::channel(Channel channel) const {
+    return planes[channel];
+}
+
+HsvImage HsvImage::fromRgb(const QImage &image) {
+    ConstPixelView src(image);
+    HsvImage hsv(src.width(), src.height());
+    if (hsv.isNull()) {
+        return hsv;
+    }
+    
+    // Detach the planes once, before the threads write to them
+    uchar *bits[3];
+    for (int c = 0; c < 3; ++c) {
+        bits[c] = hsv.planes[c].bits();
+    }
+    qsizetype stride = hsv.planes[Hue].bytesPerLine();
+    int width = src.width();
+    
+    ParallelExecutor::forEachRowBand(src.height(), [&](int firstRow, int endRow) {
+        QRgb tail[HsvLanes];
+        uchar tailPlanes[3][HsvLanes];
+        for (int y = firstRow; y < endRow; ++y) {
+            const QRgb *in = src.row(y);
+            uchar *h = bits[Hue] + y * stride;
+            uchar *s = bits[Saturation] + y * stride;
+            uchar *v = bits[Value] + y * stride;
+            
+            int x = 0;
+            for (; x + HsvLanes <= width; x += HsvLanes) {
+                rgbToHsvLanes(in + x, h + x, s + x, v + x);
+            }
+            if (x < width) {
+                std::fill(tail, tail + HsvLanes, 0u);
+                std::memcpy(tail, in + x, (width - x) * sizeof(QRgb));
+                rgbToHsvLanes(tail, tailPlanes[Hue], tailPlanes[Saturation], tailPlanes[Value]);
+                std::memcpy(h + x, tailPlanes[Hue], width - x);
+                std::memcpy(s + x, tailPlanes[Saturation], width - x);
+                std::memcpy(v + x, tailPlanes[Value], width - x);
+            }
+        }
+    });
+    
+    return hsv;
+}
+
+QImage HsvImage::toRgb() const {
+    if (isNull()) {
+        return QImage();
+    }
+    
+    QImage result(size(), QImage::Format_RGB32);
+    PixelView dst(result);
+    const uchar *bits[3];
+    for (int c = 0; c < 3; ++c) {
+        bits[c] = planes[c].constBits();
+    }
+    qsizetype stride = planes[Hue].bytesPerLine();
+    int w = width();
+    
+    ParallelExecutor::forEachRowBand(height(), [&](int firstRow, int endRow) {
+        uchar tailPlanes[3][HsvLanes];
+        QRgb tail[HsvLanes];
+        for (int y = firstRow; y < endRow; ++y) {
+            const uchar *h = bits[Hue] + y * stride;
+            const uchar *s = bits[Saturation] + y * stride;
+            const uchar *v = bits[Value] + y * stride;
+            QRgb *out = dst.row(y);
+            
+            int x = 0;
+            for (; x + HsvLanes <= w; x += HsvLanes) {
+                hsvToRgbLanes(h + x, s + x, v + x, out + x);
+            }
+            if (x < w) {
+                std::memset(tailPlanes, 0, sizeof(tailPlanes));
+                std::memcpy(tailPlanes[Hue], h + x, w - x);
+                std::memcpy(tailPlanes[Saturation], s + x, w - x);
+                std::memcpy(tailPlanes[Value], v + x, w - x);
+                hsvToRgbLanes(tailPlanes[Hue], tailPlanes[Saturation], tailPlanes[Value], tail);
+                std::memcpy(out + x, tail, (w - x) * sizeof(QRgb));
+            }
+        }
+    });
+    
+    return result;
+}
+
+QImage HsvImage::adjust(const QImage &image, const HsvAdjustment &adjustment) {
+    // Gray pixels have no hue or saturation to change
+    if (GrayView::isGrayFormat(image)) {
+        ConstGrayView src(image);
+        QImage result = GrayView::createResult(src);
+        GrayView dst(result);
+        ParallelExecutor::forEachRowBand(src.height(), [&](int firstRow, int endRow) {
+            for (int y = firstRow; y < endRow; ++y) {
+                const uchar *in = src.row(y);
+                uchar *out = dst.row(y);
+                for (int x = 0; x < src.width(); ++x) {
+                    out[x] = adjustment.value[in[x]];
+                }
+            }
+        });
+        return result;
+    }
+    
+    ConstPixelView src(image);
+    QImage result = PixelView::createResult(src);
+    if (result.isNull()) {
+        return result;
+    }
+    PixelView dst(result);
+    
+    double sixths = std::fmod(adjustment.hueShift / 60.0, 6.0);
+    int hueShift = static_cast<int>(std::lround((sixths < 0.0 ? sixths + 6.0 : sixths) * AdjustOne));
+    hueShift %= 6 * AdjustOne;
+    float saturationGain = static_cast<float>(
+        qBound(0.0, adjustment.saturationGain, MaximumSaturationGain) * AdjustOne);
+    const uchar *valueCurve = adjustment.value;
+    int width = src.width();
+    
+    ParallelExecutor::forEachRowBand(src.height(), [&](int firstRow, int endRow) {
+        QRgb tail[HsvLanes];
+        for (int y = firstRow; y < endRow; ++y) {
+            const QRgb *in = src.row(y);
+            QRgb *out = dst.row(y);
+            
+            int x = 0;
+            for (; x + HsvLanes <= width; x += HsvLanes) {
+                adjustLanes(in + x, out + x, hueShift, saturationGain, valueCurve);
+            }
+            if (x < width) {
+                std::fill(tail, tail + HsvLanes, 0u);
+                std::memcpy(tail, in + x, (width - x) * sizeof(QRgb));
+                adjustLanes(tail, tail, hueShift, saturationGain, valueCurve);
+                std::memcpy(out + x, tail, (width - x) * sizeof(QRgb));
+            }
+        }
+    });
+    
+    // Gray pixels have no saturation, so they stay gray
+    ImageMetadata::copyGrayscale(image, result);
+    return result;
+}
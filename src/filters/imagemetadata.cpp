@@ -0,0 +1,85 @@
+#include "filters/imagemetadata.h"
+#include "filters/pixelview.h"
+#include <QColorSpace>
+
+const char *const ImageMetadata::GrayscaleKey = "ImageFiltering.Grayscale";
+
+bool ImageMetadata::isGrayscale(const QImage &image) {
+    if (isMarkedGrayscale(image)) {
+        return true;
+    }
+    
+    ConstPixelView view(image);
+    for (int y = 0; y < view.height(); ++y) {
+        const QRgb *row = view.row(y);
+        
+        // R == G == B exactly when the low 16 bits of pixel ^ (pixel >> 8)
+        // are zero. The row loop has no branch, so it vectorizes.
+        quint32 difference = 0;
+        for (int x = 0; x < view.width(); ++x) {
+            difference |= (row[x] ^ (row[x] >> 8)) & 0xffff;
+        }
+        if (difference != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ImageMetadata::setGrayscale(QImage &image, bool grayscale) {
+    if (image.isNull() || grayscale == (image.text(GrayscaleKey) == "1")) {
+        return;
+    }
+    image.setText(GrayscaleKey, grayscale ? "1" : QString());
+}
+
+bool ImageMetadata::isMarkedGrayscale(const QImage &image) {
+    return image.format() == QImage::Format_Grayscale8 ||
+           image.format() == QImage::Format_Grayscale16 ||
+           image.text(GrayscaleKey) == "1";
+}
+
+void ImageMetadata::copyGrayscale(const QImage &from, QImage &to) {
+    setGrayscale(to, isMarkedGrayscale(from));
+}
+
+void ImageMetadata::prepareLoaded(QImage &image) {
+    // The file's pixels may have changed since a flag was saved with them,
+    // so only the format and the palette count
+    if (image.textKeys().contains(QLatin1String(GrayscaleKey))) {
+        image.setText(GrayscaleKey, QString());
+    }
+    
+    // Opaque gray palettes switch to the single-channel format the filters
+    // keep gray images in
+    if (image.format() == QImage::Format_Indexed8 && image.allGray() && !image.hasAlphaChannel()) {
+        image = image.convertToFormat(QImage::Format_Grayscale8);
+    }
+    
+    // Gray formats and gray palettes are known to be gray without a scan;
+    // the flag outlives the conversion to 32 bits the filters make
+    if (isMarkedGrayscale(image) || (image.format() == QImage::Format_Indexed8 && image.allGray())) {
+        setGrayscale(image, true);
+    }
+}
+
+QImage ImageMetadata::forWriting(const QImage &image) {
+    if (!image.textKeys().contains(QLatin1String(GrayscaleKey))) {
+        return image;
+    }
+    
+    // QImage cannot drop a text key, so the pixels go to a fresh image
+    QImage result = QImage(image.constBits(), image.width(), image.height(),
+                           image.bytesPerLine(), image.format()).copy();
+    result.setColorTable(image.colorTable());
+    result.setDotsPerMeterX(image.dotsPerMeterX());
+    result.setDotsPerMeterY(image.dotsPerMeterY());
+    result.setOffset(image.offset());
+    result.setColorSpace(image.colorSpace());
+    for (const QString &key : image.textKeys()) {
+        if (key != QLatin1String(GrayscaleKey)) {
+            result.setText(key, image.text(key));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,147 @@
+#include "filters/parallelexecutor.h"
+#include "filters/filterjob.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <memory>
+
+// Smallest band worth handing to another thread
+static const int MinimumBandHeight = 8;
+
+// Bands per thread, so uneven rows still balance out
+static const int BandsPerWorker = 4;
+
+namespace {
+
+struct Job
+{
+    std::function<void(int)> task;
+    int count;
+    FilterJob *owner;
+    QAtomicInt next;
+    QAtomicInt done;
+    QMutex mutex;
+    QWaitCondition finished;
+};
+
+void finishItems(Job &job, int items)
+{
+    if (job.done.fetchAndAddOrdered(items) + items == job.count) {
+        QMutexLocker locker(&job.mutex);
+        job.finished.wakeAll();
+    }
+}
+
+void runJob(Job &job)
+{
+    for (;;) {
+        // Claim an item before looking at the owner: once every item is
+        // finished, forEach() returns and the owner may be gone. A helper
+        // the pool starts late finds nothing left and never touches it.
+        int index = job.next.fetchAndAddOrdered(1);
+        if (index >= job.count) {
+            return;
+        }
+        
+        // A cancelled job takes all unclaimed items at once and skips them
+        // with the claimed one. Every item claimed before stays claimed and
+        // runs, so an item that waits on an earlier one still finds it started.
+        if (job.owner && job.owner->isCancelRequested()) {
+            int rest = job.next.fetchAndStoreOrdered(job.count);
+            finishItems(job, 1 + (rest < job.count ? job.count - rest : 0));
+            return;
+        }
+        
+        job.task(index);
+        
+        if (job.owner) {
+            job.owner->finishWork(1);
+        }
+        finishItems(job, 1);
+    }
+}
+
+int initialWorkerCount()
+{
+    bool ok = false;
+    int count = qEnvironmentVariableIntValue("IMAGEFILTERING_THREADS", &ok);
+    return ok && count > 0 ? count : 0;
+}
+
+QAtomicInt configuredWorkers(initialWorkerCount());
+
+QThreadPool *helperPool()
+{
+    static QThreadPool pool;
+    return &pool;
+}
+
+} // namespace
+
+void ParallelExecutor::setWorkerCount(int count) {
+    configuredWorkers.storeRelaxed(qMax(0, count));
+}
+
+int ParallelExecutor::workerCount() {
+    int count = configuredWorkers.loadRelaxed();
+    return count > 0 ? count : qMax(1, QThread::idealThreadCount());
+}
+
+void ParallelExecutor::forEach(int count, const std::function<void(int)> &task) {
+    int workers = qMin(workerCount(), count);
+    FilterJob *owner = FilterJob::current();
+    if (owner) {
+        owner->addWork(count);
+    }
+    
+    if (workers <= 1) {
+        for (int index = 0; index < count; ++index) {
+            if (owner && owner->isCancelRequested()) {
+                return;
+            }
+            task(index);
+            if (owner) {
+                owner->finishWork(1);
+            }
+        }
+        return;
+    }
+    
+    // Helpers may start after the work is gone, so they share ownership of the
+    // job; the owner is only reached through a claimed item (see runJob)
+    auto job = std::make_shared<Job>();
+    job->task = task;
+    job->count = count;
+    job->owner = owner;
+    
+    QThreadPool *pool = helperPool();
+    if (pool->maxThreadCount() < workers - 1) {
+        pool->setMaxThreadCount(workers - 1);
+    }
+    for (int i = 1; i < workers; ++i) {
+        pool->start([job]() {
+            FilterJob::Scope scope(job->owner);
+            runJob(*job);
+        });
+    }
+    
+    runJob(*job);
+    
+    QMutexLocker locker(&job->mutex);
+    while (job->done.loadAcquire() < count) {
+        job->finished.wait(&job->mutex);
+    }
+}
+
+void ParallelExecutor::forEachRowBand(int height, const std::function<void(int, int)> &task) {
+    int bands = qMax(1, qMin(workerCount() * BandsPerWorker, height / MinimumBandHeight));
+    
+    forEach(bands, [&](int band) {
+        int firstRow = static_cast<int>(static_cast<qint64>(height) * band / bands);
+        int endRow = static_cast<int>(static_cast<qint64>(height) * (band + 1) / bands);
+        task(firstRow, endRow);
+    });
+}
@@ -0,0 +1,98 @@
+#include "filters/pixelview.h"
+#include "filters/imagemetadata.h"
+
+// ConstPixelView implementation
+ConstPixelView::ConstPixelView(const QImage &image)
+    : source(PixelView::normalize(image))
+{
+    bits = source.constBits();
+    stride = source.bytesPerLine();
+    w = source.width();
+    h = source.height();
+}
+
+// PixelView implementation
+PixelView::PixelView(QImage &image)
+{
+    // bits() detaches once here instead of on every setPixel()
+    bits = image.bits();
+    stride = image.bytesPerLine();
+    w = image.width();
+    h = image.height();
+}
+
+QImage::Format PixelView::internalFormat(const QImage &image) {
+    return image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+}
+
+QImage PixelView::normalize(const QImage &image) {
+    QImage::Format format = internalFormat(image);
+    if (image.format() == format) {
+        return image;
+    }
+    return image.convertToFormat(format);
+}
+
+// Keep resolution and text metadata the way image.copy() would, except the
+// grayscale flag: filters that keep gray images gray copy it back
+static void copyMetadata(const QImage &image, QImage &result) {
+    result.setDotsPerMeterX(image.dotsPerMeterX());
+    result.setDotsPerMeterY(image.dotsPerMeterY());
+    for (const QString &key : image.textKeys()) {
+        if (key == QLatin1String(ImageMetadata::GrayscaleKey)) {
+            continue;
+        }
+        result.setText(key, image.text(key));
+    }
+}
+
+QImage PixelView::createResult(const ConstPixelView &source) {
+    const QImage &image = source.image();
+    QImage result(image.size(), image.format());
+    copyMetadata(image, result);
+    return result;
+}
+
+// ConstGrayView implementation
+ConstGrayView::ConstGrayView(const QImage &image)
+    : source(GrayView::normalize(image))
+{
+    bits = source.constBits();
+    stride = source.bytesPerLine();
+    w = source.width();
+    h = source.height();
+}
+
+// GrayView implementation
+GrayView::GrayView(QImage &image)
+{
+    bits = image.bits();
+    stride = image.bytesPerLine();
+    w = image.width();
+    h = image.height();
+}
+
+bool GrayView::isGrayFormat(const QImage &image) {
+    return image.format() == QImage::Format_Grayscale8 || image.format() == QImage::Format_Grayscale16;
+}
+
+QImage GrayView::normalize(const QImage &image) {
+    if (image.format() == QImage::Format_Grayscale8) {
+        return image;
+    }
+    return image.convertToFormat(QImage::Format_Grayscale8);
+}
+
+QImage GrayView::createResult(const ConstGrayView &source) {
+    const QImage &image = source.image();
+    QImage result(image.size(), QImage::Format_Grayscale8);
+    copyMetadata(image, result);
+    return result;
+}
+
+QImage GrayView::createResult(const ConstPixelView &source) {
+    const QImage &image = source.image();
+    QImage result(image.size(), QImage::Format_Grayscale8);
+    copyMetadata(image, result);
+    return result;
+}
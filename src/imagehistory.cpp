@@ -0,0 +1,311 @@
+#include "imagehistory.h"
+#include "filters/parallelexecutor.h"
+#include <QAtomicInt>
+#include <cstring>
+
+// Default budget when neither the caller nor the environment sets one
+static const qint64 DefaultBudget = qint64(1) << 30;
+
+// Uncompressed size of one chunk; chunks compress in parallel
+static const qint64 ChunkBytes = qint64(1) << 22;
+
+// zlib level: the fastest one, history compression sits on the undo path
+static const int CompressionLevel = 1;
+
+static qint64 defaultBudget()
+{
+    bool ok = false;
+    int megabytes = qEnvironmentVariableIntValue("IMAGEFILTERING_HISTORY_MB", &ok);
+    return ok && megabytes > 0 ? qint64(megabytes) << 20 : DefaultBudget;
+}
+
+// dst = a ^ b over length bytes
+static void xorBytes(uchar *dst, const uchar *a, const uchar *b, qint64 length)
+{
+    for (qint64 i = 0; i < length; ++i) {
+        dst[i] = a[i] ^ b[i];
+    }
+}
+
+ImageHistory::ImageHistory(qint64 budget)
+    : budget(budget > 0 ? budget : defaultBudget())
+{
+}
+
+void ImageHistory::setBudget(qint64 bytes) {
+    budget = bytes > 0 ? bytes : defaultBudget();
+    enforceBudget();
+}
+
+qint64 ImageHistory::getBudget() const {
+    return budget;
+}
+
+void ImageHistory::push(const QImage &image) {
+    if (image.isNull()) {
+        return;
+    }
+    
+    // A DELTA on top refers to the image popped last. Pushing anything else
+    // on it (an image changed without a history entry) needs it rebuilt.
+    if (!entries.isEmpty() && entries.last().storage == DELTA && image.cacheKey() != base.cacheKey()) {
+        QImage top = restore(entries.last(), base);
+        if (top.isNull()) {
+            entries.clear();
+        } else {
+            entries.last() = Entry();
+            entries.last().storage = PLAIN;
+            entries.last().image = top;
+        }
+        truncateSpill();
+    }
+    
+    Entry entry;
+    entry.storage = PLAIN;
+    entry.image = image;
+    entries.append(entry);
+    base = QImage();
+    
+    enforceBudget();
+}
+
+QImage ImageHistory::pop() {
+    if (entries.isEmpty()) {
+        return QImage();
+    }
+    
+    Entry entry = entries.takeLast();
+    QImage image = entry.storage == PLAIN ? entry.image : restore(entry, base);
+    
+    // Every older entry depends on this one
+    if (image.isNull()) {
+        clear();
+        return image;
+    }
+    
+    base = image;
+    if (entries.isEmpty()) {
+        clear();
+    } else {
+        truncateSpill();
+    }
+    return image;
+}
+
+bool ImageHistory::isEmpty() const {
+    return entries.isEmpty();
+}
+
+int ImageHistory::size() const {
+    return entries.size();
+}
+
+void ImageHistory::clear() {
+    entries.clear();
+    base = QImage();
+    
+    if (spillFile.isOpen()) {
+        spillFile.resize(0);
+    }
+}
+
+qint64 ImageHistory::memoryUsage() const {
+    qint64 bytes = 0;
+    for (const Entry &entry : entries) {
+        bytes += entryBytes(entry);
+    }
+    return bytes;
+}
+
+qint64 ImageHistory::entryBytes(const Entry &entry) {
+    if (entry.storage == PLAIN) {
+        return entry.image.sizeInBytes();
+    }
+    
+    qint64 bytes = 0;
+    for (const QByteArray &chunk : entry.chunks) {
+        bytes += chunk.size();
+    }
+    return bytes;
+}
+
+void ImageHistory::enforceBudget() {
+    qint64 usage = memoryUsage();
+    
+    // Compressed entries form the oldest part of the stack; the newest entry
+    // always stays plain
+    for (int index = 0; usage > budget && index + 1 < entries.size(); ++index) {
+        if (entries[index].storage == PLAIN) {
+            usage -= entryBytes(entries[index]);
+            compress(index);
+            usage += entryBytes(entries[index]);
+        }
+    }
+    
+    for (int index = 0; usage > budget && index + 1 < entries.size(); ++index) {
+        Entry &entry = entries[index];
+        if (entry.storage != PLAIN && !entry.chunks.isEmpty()) {
+            qint64 bytes = entryBytes(entry);
+            if (!spill(entry)) {
+                return;
+            }
+            usage -= bytes;
+        }
+    }
+}
+
+void ImageHistory::compress(int index) {
+    Entry &entry = entries[index];
+    QImage image = entry.image;
+    const QImage &newer = entries[index + 1].image;
+    
+    bool delta = entries[index + 1].storage == PLAIN && newer.format() == image.format() &&
+                 newer.size() == image.size() && newer.bytesPerLine() == image.bytesPerLine();
+    
+    qint64 bytesPerLine = image.bytesPerLine();
+    int rowsPerChunk = static_cast<int>(qBound<qint64>(1, ChunkBytes / qMax<qint64>(1, bytesPerLine), image.height()));
+    int chunkCount = (image.height() + rowsPerChunk - 1) / rowsPerChunk;
+    
+    QVector<QByteArray> chunks(chunkCount);
+    QByteArray *compressedChunks = chunks.data();
+    ParallelExecutor::forEach(chunkCount, [&](int chunk) {
+        int firstRow = chunk * rowsPerChunk;
+        int rows = qMin(rowsPerChunk, image.height() - firstRow);
+        qint64 length = rows * bytesPerLine;
+        const uchar *pixels = image.constBits() + firstRow * bytesPerLine;
+        
+        if (delta) {
+            QByteArray difference(length, Qt::Uninitialized);
+            xorBytes(reinterpret_cast<uchar *>(difference.data()), pixels,
+                     newer.constBits() + firstRow * bytesPerLine, length);
+            compressedChunks[chunk] = qCompress(difference, CompressionLevel);
+        } else {
+            compressedChunks[chunk] = qCompress(pixels, length, CompressionLevel);
+        }
+    });
+    
+    Entry compressed;
+    compressed.storage = delta ? DELTA : COMPRESSED;
+    compressed.width = image.width();
+    compressed.height = image.height();
+    compressed.format = image.format();
+    compressed.colorTable = image.colorTable();
+    for (const QString &key : image.textKeys()) {
+        compressed.text[key] = image.text(key);
+    }
+    compressed.dotsPerMeterX = image.dotsPerMeterX();
+    compressed.dotsPerMeterY = image.dotsPerMeterY();
+    compressed.offset = image.offset();
+    compressed.colorSpace = image.colorSpace();
+    compressed.rowsPerChunk = rowsPerChunk;
+    compressed.chunks = chunks;
+    entry = compressed;
+}
+
+bool ImageHistory::spill(Entry &entry) {
+    if (!spillFile.isOpen() && !spillFile.open()) {
+        return false;
+    }
+    
+    QVector<qint64> offsets;
+    QVector<qint64> sizes;
+    qint64 offset = spillFile.size();
+    if (!spillFile.seek(offset)) {
+        return false;
+    }
+    
+    for (const QByteArray &chunk : entry.chunks) {
+        if (spillFile.write(chunk) != chunk.size()) {
+            return false;
+        }
+        offsets.append(offset);
+        sizes.append(chunk.size());
+        offset += chunk.size();
+    }
+    
+    entry.chunks.clear();
+    entry.spillOffsets = offsets;
+    entry.spillSizes = sizes;
+    return true;
+}
+
+void ImageHistory::truncateSpill() {
+    if (!spillFile.isOpen()) {
+        return;
+    }
+    
+    qint64 end = 0;
+    for (const Entry &entry : entries) {
+        for (int i = 0; i < entry.spillOffsets.size(); ++i) {
+            end = qMax(end, entry.spillOffsets[i] + entry.spillSizes[i]);
+        }
+    }
+    if (end < spillFile.size()) {
+        spillFile.resize(end);
+    }
+}
+
+QImage ImageHistory::restore(const Entry &entry, const QImage &newer) {
+    QImage image(entry.width, entry.height, entry.format);
+    if (image.isNull()) {
+        return QImage();
+    }
+    
+    bool delta = entry.storage == DELTA;
+    if (delta && (newer.format() != image.format() || newer.size() != image.size() ||
+                  newer.bytesPerLine() != image.bytesPerLine())) {
+        return QImage();
+    }
+    
+    // Spilled chunks are read back one after the other, then decompressed in parallel
+    QVector<QByteArray> chunks = entry.chunks;
+    if (chunks.isEmpty()) {
+        for (int i = 0; i < entry.spillOffsets.size(); ++i) {
+            if (!spillFile.seek(entry.spillOffsets[i])) {
+                return QImage();
+            }
+            chunks.append(spillFile.read(entry.spillSizes[i]));
+        }
+    }
+    
+    qint64 bytesPerLine = image.bytesPerLine();
+    int chunkCount = (entry.height + entry.rowsPerChunk - 1) / entry.rowsPerChunk;
+    if (chunks.size() != chunkCount) {
+        return QImage();
+    }
+    
+    QAtomicInt failed(0);
+    uchar *bits = image.bits();
+    ParallelExecutor::forEach(chunkCount, [&](int chunk) {
+        int firstRow = chunk * entry.rowsPerChunk;
+        int rows = qMin(entry.rowsPerChunk, entry.height - firstRow);
+        qint64 length = rows * bytesPerLine;
+        
+        QByteArray data = qUncompress(chunks[chunk]);
+        if (data.size() != length) {
+            failed.storeRelaxed(1);
+            return;
+        }
+        
+        const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+        uchar *out = bits + firstRow * bytesPerLine;
+        if (delta) {
+            xorBytes(out, bytes, newer.constBits() + firstRow * bytesPerLine, length);
+        } else {
+            std::memcpy(out, bytes, length);
+        }
+    });
+    if (failed.loadRelaxed()) {
+        return QImage();
+    }
+    
+    image.setColorTable(entry.colorTable);
+    for (auto it = entry.text.constBegin(); it != entry.text.constEnd(); ++it) {
+        image.setText(it.key(), it.value());
+    }
+    image.setDotsPerMeterX(entry.dotsPerMeterX);
+    image.setDotsPerMeterY(entry.dotsPerMeterY);
+    image.setOffset(entry.offset);
+    image.setColorSpace(entry.colorSpace);
+    return image;
+}
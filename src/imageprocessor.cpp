@@ -53,6 +53,45 @@ QImage ImageProcessor::applyDithering(const QImage &image, int rLevels, int gLev
     return filter.apply(image);
 }
 
+QImage ImageProcessor::applyHueRotation(const QImage &image, double degrees) {
+    HueRotationFilter filter(degrees);
+    return filter.apply(image);
+}
+
+QImage ImageProcessor::applySaturation(const QImage &image, double gain) {
+    SaturationFilter filter(gain);
+    return filter.apply(image);
+}
+
+QImage ImageProcessor::applyValueAdjustment(const QImage &image, double gain, double gamma) {
+    ValueFilter filter(gain, gamma);
+    return filter.apply(image);
+}
+
+QImage ImageProcessor::applyPointFilterChain(const QImage &image, const QVector<FunctionFilter *> &filters) {
+    QImage result = image;
+    PointFilterChain chain;
+    
+    for (FunctionFilter *filter : filters) {
+        if (chain.append(*filter)) {
+            continue;
+        }
+        
+        // Not a point filter: flush the fused run, then apply it on its own
+        if (chain.size() > 0) {
+            result = chain.apply(result);
+            chain.clear();
+        }
+        result = filter->apply(result);
+    }
+    
+    if (chain.size() > 0) {
+        result = chain.apply(result);
+    }
+    
+    return result;
+}
+
 QStringList ImageProcessor::getDitheringKernelNames() const {
     return DitheringFilter::getKernelNames();
 }
@@ -63,8 +102,10 @@ QImage ImageProcessor::applyConvolutionFilter(const QImage &image,
                                             double divisor,
                                             double offset,
                                             int anchorX,
-                                            int anchorY) {
+                                            int anchorY,
+                                            BorderExtension::Mode boundary) {
     CustomFilter filter("Custom", kernel, divisor, offset);
+    filter.setBoundaryMode(boundary);
     
     if (anchorX >= 0) {
         filter.setAnchorX(anchorX);
@@ -103,8 +144,9 @@ QImage ImageProcessor::applyEmboss(const QImage &image) {
 }
 
 // Median filter
-QImage ImageProcessor::applyMedianFilter(const QImage &image, int size) {
+QImage ImageProcessor::applyMedianFilter(const QImage &image, int size, BorderExtension::Mode boundary) {
     MedianFilter filter(size);
+    filter.setBoundaryMode(boundary);
     return filter.apply(image);
 }
 
@@ -167,50 +209,6 @@ QRgb ImageProcessor::applyFunctionToPixel(QRgb pixel, std::function<int(int)> fu
     return qRgba(r, g, b, qAlpha(pixel));
 }
 
-QRgb ImageProcessor::applyConvolutionToPixel(const QImage &image, int x, int y, 
-                                           const QVector<QVector<double>> &kernel,
-                                           double divisor, double offset,
-                                           int anchorX, int anchorY) {
-    double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-    
-    if (anchorX < 0) {
-        anchorX = kernel[0].size() / 2;
-    }
-    
-    if (anchorY < 0) {
-        anchorY = kernel.size() / 2;
-    }
-    
-    for (int ky = 0; ky < kernel.size(); ++ky) {
-        for (int kx = 0; kx < kernel[ky].size(); ++kx) {
-            int imageX = x + kx - anchorX;
-            int imageY = y + ky - anchorY;
-            
-            QRgb pixel = getPixelWithBoundary(image, imageX, imageY);
-            
-            sumR += qRed(pixel) * kernel[ky][kx];
-            sumG += qGreen(pixel) * kernel[ky][kx];
-            sumB += qBlue(pixel) * kernel[ky][kx];
-        }
-    }
-    
-    int r = qBound(0, static_cast<int>(sumR / divisor + offset), 255);
-    int g = qBound(0, static_cast<int>(sumG / divisor + offset), 255);
-    int b = qBound(0, static_cast<int>(sumB / divisor + offset), 255);
-    
-    return qRgba(r, g, b, qAlpha(image.pixel(x, y)));
-}
-
-QRgb ImageProcessor::getPixelWithBoundary(const QImage &image, int x, int y) {
-    // Handle boundary conditions (mirror at edges)
-    if (x < 0) x = -x;
-    if (y < 0) y = -y;
-    if (x >= image.width()) x = 2 * image.width() - x - 1;
-    if (y >= image.height()) y = 2 * image.height() - y - 1;
-    
-    return image.pixel(x, y);
-}
-
 // Save and load custom filters
 bool ImageProcessor::saveCustomFilter(const QString &name, 
                                     const QVector<QVector<double>> &kernel,
@@ -300,7 +298,24 @@ bool ImageProcessor::loadCustomFilter(const QString &name,
     return true;
 }
 
-QStringList ImageProcessor::getCustomFilterNames() const {
+// Read a file under filters/ as a JSON object
+static bool readFilterFile(const QString &name, QJsonObject &object) {
+    QFile file("filters/" + name + ".json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    if (doc.isNull() || !doc.isObject()) {
+        return false;
+    }
+    
+    object = doc.object();
+    return true;
+}
+
+// Names of the files under filters/, graphs or custom kernels
+static QStringList filterFileNames(bool graphs) {
     QDir dir("filters");
     QStringList filters;
     filters << "*.json";
@@ -308,140 +323,80 @@ QStringList ImageProcessor::getCustomFilterNames() const {
     
     QStringList result;
     for (const QString &fileName : fileNames) {
-        result.append(fileName.left(fileName.length() - 5)); // Remove .json extension
+        QString name = fileName.left(fileName.length() - 5); // Remove .json extension
+        QJsonObject object;
+        if (readFilterFile(name, object) && FilterGraph::isGraph(object) == graphs) {
+            result.append(name);
+        }
     }
     
     return result;
 }
 
-QImage ImageProcessor::convertToHSV(const QImage &image)
-{
-    QImage hsvImage(image.size(), QImage::Format_RGB32);
-    
-    for (int y = 0; y < image.height(); ++y) {
-        for (int x = 0; x < image.width(); ++x) {
-            QRgb pixel = image.pixel(x, y);
-            int r = qRed(pixel);
-            int g = qGreen(pixel);
-            int b = qBlue(pixel);
-            
-            // Convert RGB to HSV
-            double r_norm = r / 255.0;
-            double g_norm = g / 255.0;
-            double b_norm = b / 255.0;
-            
-            double max = qMax(qMax(r_norm, g_norm), b_norm);
-            double min = qMin(qMin(r_norm, g_norm), b_norm);
-            double delta = max - min;
-            
-            double h = 0.0;
-            double s = (max == 0) ? 0 : delta / max;
-            double v = max;
-            
-            if (delta != 0) {
-                if (max == r_norm) {
-                    h = 60 * fmod(((g_norm - b_norm) / delta), 6);
-                } else if (max == g_norm) {
-                    h = 60 * (((b_norm - r_norm) / delta) + 2);
-                } else {
-                    h = 60 * (((r_norm - g_norm) / delta) + 4);
-                }
-            }
-            
-            if (h < 0) h += 360;
-            
-            // Store HSV values in RGB channels (H in R, S in G, V in B)
-            hsvImage.setPixel(x, y, qRgb(
-                static_cast<int>(h * 255.0 / 360.0),
-                static_cast<int>(s * 255.0),
-                static_cast<int>(v * 255.0)
-            ));
-        }
-    }
-    
-    return hsvImage;
+QStringList ImageProcessor::getCustomFilterNames() const {
+    return filterFileNames(false);
 }
 
-QImage ImageProcessor::convertToRGB(const QImage &hsvImage)
-{
-    QImage rgbImage(hsvImage.size(), QImage::Format_RGB32);
-    
-    for (int y = 0; y < hsvImage.height(); ++y) {
-        for (int x = 0; x < hsvImage.width(); ++x) {
-            QRgb pixel = hsvImage.pixel(x, y);
-            double h = qRed(pixel) * 360.0 / 255.0;
-            double s = qGreen(pixel) / 255.0;
-            double v = qBlue(pixel) / 255.0;
-            
-            // Convert HSV to RGB
-            double c = v * s;
-            double x_val = c * (1 - std::abs(fmod(h / 60.0, 2) - 1));
-            double m = v - c;
-            double r = 0, g = 0, b = 0;
-            
-            if (h < 60) {
-                r = c; g = x_val; b = 0;
-            } else if (h < 120) {
-                r = x_val; g = c; b = 0;
-            } else if (h < 180) {
-                r = 0; g = c; b = x_val;
-            } else if (h < 240) {
-                r = 0; g = x_val; b = c;
-            } else if (h < 300) {
-                r = x_val; g = 0; b = c;
-            } else {
-                r = c; g = 0; b = x_val;
-            }
-            
-            rgbImage.setPixel(x, y, qRgb(
-                static_cast<int>((r + m) * 255),
-                static_cast<int>((g + m) * 255),
-                static_cast<int>((b + m) * 255)
-            ));
-        }
+bool ImageProcessor::saveFilterGraph(const QString &name, const FilterGraph &graph) {
+    if (!graph.isValid()) {
+        return false;
     }
     
-    return rgbImage;
-}
-
-QImage ImageProcessor::getHueChannel(const QImage &hsvImage)
-{
-    QImage hueImage(hsvImage.size(), QImage::Format_Grayscale8);
+    FilterGraph named = graph;
+    named.setName(name);
     
-    for (int y = 0; y < hsvImage.height(); ++y) {
-        for (int x = 0; x < hsvImage.width(); ++x) {
-            QRgb pixel = hsvImage.pixel(x, y);
-            hueImage.setPixel(x, y, qRgb(qRed(pixel), qRed(pixel), qRed(pixel)));
-        }
+    QJsonDocument doc(named.toJson());
+    QFile file("filters/" + name + ".json");
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
     }
     
-    return hueImage;
+    return file.write(doc.toJson()) >= 0;
 }
 
-QImage ImageProcessor::getSaturationChannel(const QImage &hsvImage)
-{
-    QImage saturationImage(hsvImage.size(), QImage::Format_Grayscale8);
+bool ImageProcessor::loadFilterGraph(const QString &name, FilterGraph &graph, QString &error) {
+    QJsonObject object;
+    if (!readFilterFile(name, object) || !FilterGraph::isGraph(object)) {
+        error = QString("'%1' is not a readable filter graph").arg(name);
+        return false;
+    }
     
-    for (int y = 0; y < hsvImage.height(); ++y) {
-        for (int x = 0; x < hsvImage.width(); ++x) {
-            QRgb pixel = hsvImage.pixel(x, y);
-            saturationImage.setPixel(x, y, qRgb(qGreen(pixel), qGreen(pixel), qGreen(pixel)));
-        }
+    graph = FilterGraph::fromJson(object, error);
+    if (!graph.isValid()) {
+        return false;
     }
     
-    return saturationImage;
+    if (graph.getName().isEmpty()) {
+        graph.setName(name);
+    }
+    return true;
 }
 
-QImage ImageProcessor::getValueChannel(const QImage &hsvImage)
+QStringList ImageProcessor::getFilterGraphNames() const {
+    return filterFileNames(true);
+}
+
+HsvImage ImageProcessor::convertToHSV(const QImage &image)
 {
-    QImage valueImage(hsvImage.size(), QImage::Format_Grayscale8);
-    
-    for (int y = 0; y < hsvImage.height(); ++y) {
-        for (int x = 0; x < hsvImage.width(); ++x) {
-            QRgb pixel = hsvImage.pixel(x, y);
-            valueImage.setPixel(x, y, qRgb(qBlue(pixel), qBlue(pixel), qBlue(pixel)));
-        }
-    }
-    
-    return valueImage;
-} 
\ No newline at end of file
+    return HsvImage::fromRgb(image);
+}
+
+QImage ImageProcessor::convertToRGB(const HsvImage &hsvImage)
+{
+    return hsvImage.toRgb();
+}
+
+QImage ImageProcessor::getHueChannel(const HsvImage &hsvImage)
+{
+    return hsvImage.channel(HsvImage::Hue);
+}
+
+QImage ImageProcessor::getSaturationChannel(const HsvImage &hsvImage)
+{
+    return hsvImage.channel(HsvImage::Saturation);
+}
+
+QImage ImageProcessor::getValueChannel(const HsvImage &hsvImage)
+{
+    return hsvImage.channel(HsvImage::Value);
+}
@@ -1,4 +1,6 @@
 #include "mainwindow.h"
+#include "filters/pixelview.h"
+#include "filters/imagemetadata.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QImageReader>
@@ -27,20 +29,51 @@
 #include <QTableWidget>
 #include <QHeaderView>
 #include <QLineEdit>
+#include <QProgressBar>
+#include <QThread>
+#include <QTimer>
+#include <QScrollBar>
 #include <QDebug>
 
+// Quiet time after the last parameter change before the preview renders
+static const int PreviewDelayMs = 30;
+
+// Preview crops start on this grid, so threshold dithering matrices line up
+static const int PreviewAlignment = 64;
+
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent)
+    : QMainWindow(parent), filterThread(nullptr), previewGeneration(0)
 {
+    previewPool.setMaxThreadCount(1);
+    
     setupUI();
     setupMenus();
     setupConnections();
     
+    // Progress of the running filter
+    progressBar = new QProgressBar(this);
+    progressBar->setRange(0, 100);
+    progressBar->setMaximumWidth(200);
+    progressBar->hide();
+    statusBar()->addPermanentWidget(progressBar);
+    
     statusBar()->showMessage(tr("Ready"));
 }
 
 MainWindow::~MainWindow()
 {
+    // Stop running filters before the processor they use goes away
+    previewGeneration.fetchAndAddOrdered(1);
+    if (previewJob) {
+        previewJob->cancel();
+    }
+    previewPool.waitForDone();
+    
+    if (filterThread) {
+        filterJob->cancel();
+        filterThread->wait();
+        delete filterThread;
+    }
 }
 
 void MainWindow::setupUI()
@@ -97,6 +130,24 @@ void MainWindow::setupUI()
     gammaSpinBox->setSingleStep(0.1);
     functionParamsLayout->addRow("Gamma:", gammaSpinBox);
     
+    hueSpinBox = new QDoubleSpinBox(this);
+    hueSpinBox->setRange(-180.0, 180.0);
+    hueSpinBox->setValue(0.0);
+    hueSpinBox->setSingleStep(5.0);
+    functionParamsLayout->addRow("Hue Shift:", hueSpinBox);
+    
+    saturationSpinBox = new QDoubleSpinBox(this);
+    saturationSpinBox->setRange(0.0, 4.0);
+    saturationSpinBox->setValue(1.0);
+    saturationSpinBox->setSingleStep(0.1);
+    functionParamsLayout->addRow("Saturation:", saturationSpinBox);
+    
+    valueSpinBox = new QDoubleSpinBox(this);
+    valueSpinBox->setRange(0.0, 4.0);
+    valueSpinBox->setValue(1.0);
+    valueSpinBox->setSingleStep(0.1);
+    functionParamsLayout->addRow("Value:", valueSpinBox);
+    
     // Uniform quantization parameters
     quantizationParamsGroup = new QGroupBox("Uniform Quantization Parameters", this);
     QFormLayout *quantizationParamsLayout = new QFormLayout(quantizationParamsGroup);
@@ -237,12 +288,17 @@ void MainWindow::setupUI()
     // Action buttons
     QHBoxLayout *actionButtonLayout = new QHBoxLayout();
     
+    livePreviewCheckBox = new QCheckBox("Live Preview", this);
     applyButton = new QPushButton("Apply Filter", this);
+    cancelButton = new QPushButton("Cancel", this);
+    cancelButton->setEnabled(false);
     undoButton = new QPushButton("Undo", this);
     resetButton = new QPushButton("Reset", this);
     saveButton = new QPushButton("Save Image", this);
     
+    actionButtonLayout->addWidget(livePreviewCheckBox);
     actionButtonLayout->addWidget(applyButton);
+    actionButtonLayout->addWidget(cancelButton);
     actionButtonLayout->addWidget(undoButton);
     actionButtonLayout->addWidget(resetButton);
     actionButtonLayout->addWidget(saveButton);
@@ -319,6 +375,13 @@ void MainWindow::setupUI()
     scrollArea->setWidget(imageLabel);
     scrollArea->setWidgetResizable(true);
     
+    // The live preview covers the visible part of the edited image
+    previewLabel = new QLabel(imageLabel);
+    previewLabel->hide();
+    previewTimer = new QTimer(this);
+    previewTimer->setSingleShot(true);
+    previewTimer->setInterval(PreviewDelayMs);
+    
     editedImageLayout->addWidget(editedImageTitle);
     editedImageLayout->addWidget(scrollArea);
     
@@ -377,6 +440,8 @@ void MainWindow::setupMenus()
     QAction *applyAction = filterMenu->addAction(tr("&Apply Filter"), this, &MainWindow::applyFilter);
     applyAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_A));
     
+    filterMenu->addAction(tr("Apply Filter &Graph..."), this, &MainWindow::applyFilterGraph);
+    
     // Help menu
     QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
     
@@ -415,8 +480,35 @@ void MainWindow::setupConnections()
     // Kernel table changes
     connect(kernelTable, &QTableWidget::itemChanged, this, &MainWindow::updateFilterPreview);
     
+    // Live preview: any change to the filter or the visible area renders it again
+    connect(livePreviewCheckBox, &QCheckBox::toggled, [this](bool checked) {
+        if (checked) {
+            schedulePreview();
+        } else {
+            clearPreview();
+        }
+    });
+    connect(previewTimer, &QTimer::timeout, this, &MainWindow::renderPreview);
+    
+    for (QComboBox *comboBox : { filterTypeComboBox, filterSelectionComboBox, kernelTypeComboBox }) {
+        connect(comboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::schedulePreview);
+    }
+    for (QSpinBox *spinBox : { redLevelsSpinBox, greenLevelsSpinBox, blueLevelsSpinBox,
+                               ditherRedLevelsSpinBox, ditherGreenLevelsSpinBox, ditherBlueLevelsSpinBox,
+                               anchorXSpinBox, anchorYSpinBox, medianSizeSpinBox }) {
+        connect(spinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::schedulePreview);
+    }
+    for (QDoubleSpinBox *spinBox : { brightnessSpinBox, contrastSpinBox, gammaSpinBox, hueSpinBox,
+                                     saturationSpinBox, valueSpinBox, divisorSpinBox, offsetSpinBox }) {
+        connect(spinBox, QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &MainWindow::schedulePreview);
+    }
+    for (QScrollBar *scrollBar : { scrollArea->horizontalScrollBar(), scrollArea->verticalScrollBar() }) {
+        connect(scrollBar, &QScrollBar::valueChanged, this, &MainWindow::schedulePreview);
+    }
+    
     // Buttons
     connect(applyButton, &QPushButton::clicked, this, &MainWindow::applyFilter);
+    connect(cancelButton, &QPushButton::clicked, this, &MainWindow::cancelFilter);
     connect(undoButton, &QPushButton::clicked, this, &MainWindow::undoFilter);
     connect(resetButton, &QPushButton::clicked, this, &MainWindow::resetImage);
     connect(saveButton, &QPushButton::clicked, this, &MainWindow::saveImage);
@@ -508,6 +600,14 @@ void MainWindow::openImage()
         return;
     }
     
+    ImageMetadata::prepareLoaded(originalImage);
+    
+    // A running filter belongs to the previous image
+    if (filterThread) {
+        filterJob->cancel();
+        filterThread->wait();
+    }
+    
     // Clear history and update display
     imageHistory.clear();
     currentImage = originalImage;
@@ -539,7 +639,7 @@ void MainWindow::saveImage()
     
     QImageWriter writer(fileName);
     
-    if (!writer.write(currentImage)) {
+    if (!writer.write(ImageMetadata::forWriting(currentImage))) {
         QMessageBox::warning(this, tr("Error"),
                             tr("Cannot save %1: %2")
                             .arg(QDir::toNativeSeparators(fileName), writer.errorString()));
@@ -551,7 +651,7 @@ void MainWindow::saveImage()
 
 void MainWindow::resetImage()
 {
-    if (originalImage.isNull()) {
+    if (originalImage.isNull() || filterThread) {
         return;
     }
     
@@ -571,11 +671,60 @@ void MainWindow::applyFilter()
         return;
     }
     
-    // Save current image for undo
-    imageHistory.push(currentImage);
+    if (filterThread) {
+        return;
+    }
+    
+    int margin = 0;
+    std::function<QImage(const QImage &)> filter = selectedFilter(margin);
+    if (!filter) {
+        return;
+    }
+    
+    startFilterJob(filterSelectionComboBox->currentText(), filter);
+}
+
+void MainWindow::applyFilterGraph()
+{
+    if (currentImage.isNull()) {
+        QMessageBox::information(this, tr("No Image"),
+                                tr("Please open an image first."));
+        return;
+    }
+    
+    if (filterThread) {
+        return;
+    }
+    
+    QStringList graphs = processor.getFilterGraphNames();
+    if (graphs.isEmpty()) {
+        QMessageBox::information(this, tr("No Filter Graphs"),
+                                tr("No filter graphs found. Save graph files in the filters directory first."));
+        return;
+    }
+    
+    bool ok;
+    QString graphName = QInputDialog::getItem(this, tr("Apply Filter Graph"),
+                                             tr("Select a filter graph:"), graphs, 0, false, &ok);
+    if (!ok || graphName.isEmpty()) {
+        return;
+    }
+    
+    FilterGraph graph;
+    QString error;
+    if (!processor.loadFilterGraph(graphName, graph, error)) {
+        QMessageBox::warning(this, tr("Error"),
+                            tr("Failed to load filter graph '%1': %2").arg(graphName, error));
+        return;
+    }
     
-    // Apply selected filter
-    QImage result;
+    startFilterJob(graph.getName(), [graph](const QImage &image) { return graph.apply(image); });
+}
+
+std::function<QImage(const QImage &)> MainWindow::selectedFilter(int &margin)
+{
+    // Read every setting here; the filter itself runs on a worker thread
+    std::function<QImage(const QImage &)> filter;
     int filterType = filterTypeComboBox->currentIndex();
     int filterIndex = filterSelectionComboBox->currentIndex();
     
@@ -585,60 +734,98 @@ void MainWindow::applyFilter()
     if (filterType == 0) { // Function filters
         switch (filterIndex) {
             case 0: // Inversion
-                result = processor.applyInversion(currentImage);
+                filter = [this](const QImage &image) { return processor.applyInversion(image); };
                 break;
-            case 1: // Brightness
-                result = processor.applyBrightnessCorrection(currentImage, brightnessSpinBox->value());
+            case 1: { // Brightness
+                double factor = brightnessSpinBox->value();
+                filter = [this, factor](const QImage &image) {
+                    return processor.applyBrightnessCorrection(image, factor);
+                };
                 break;
-            case 2: // Contrast
-                result = processor.applyContrastEnhancement(currentImage, contrastSpinBox->value());
+            }
+            case 2: { // Contrast
+                double factor = contrastSpinBox->value();
+                filter = [this, factor](const QImage &image) {
+                    return processor.applyContrastEnhancement(image, factor);
+                };
                 break;
-            case 3: // Gamma
-                result = processor.applyGammaCorrection(currentImage, gammaSpinBox->value());
+            }
+            case 3: { // Gamma
+                double gamma = gammaSpinBox->value();
+                filter = [this, gamma](const QImage &image) {
+                    return processor.applyGammaCorrection(image, gamma);
+                };
                 break;
+            }
             case 4: // Grayscale
-                result = processor.applyGrayscale(currentImage);
+                filter = [this](const QImage &image) { return processor.applyGrayscale(image); };
                 break;
-            case 5: // Uniform Quantization
-                result = processor.applyUniformQuantization(currentImage, 
-                                                           redLevelsSpinBox->value(),
-                                                           greenLevelsSpinBox->value(),
-                                                           blueLevelsSpinBox->value());
+            case 5: { // Uniform Quantization
+                int red = redLevelsSpinBox->value();
+                int green = greenLevelsSpinBox->value();
+                int blue = blueLevelsSpinBox->value();
+                filter = [this, red, green, blue](const QImage &image) {
+                    return processor.applyUniformQuantization(image, red, green, blue);
+                };
                 break;
-            case 6: // Dithering
+            }
+            case 6: { // Dithering
                 // Convert combobox index to kernel type
                 kernelType = static_cast<DitheringFilter::KernelType>(kernelTypeComboBox->currentIndex());
                 
-                result = processor.applyDithering(currentImage,
-                                                 ditherRedLevelsSpinBox->value(),
-                                                 ditherGreenLevelsSpinBox->value(),
-                                                 ditherBlueLevelsSpinBox->value(),
-                                                 kernelType);
+                int red = ditherRedLevelsSpinBox->value();
+                int green = ditherGreenLevelsSpinBox->value();
+                int blue = ditherBlueLevelsSpinBox->value();
+                filter = [this, red, green, blue, kernelType](const QImage &image) {
+                    return processor.applyDithering(image, red, green, blue, kernelType);
+                };
+                break;
+            }
+            case 7: { // Hue Rotation
+                double degrees = hueSpinBox->value();
+                filter = [this, degrees](const QImage &image) {
+                    return processor.applyHueRotation(image, degrees);
+                };
+                break;
+            }
+            case 8: { // Saturation
+                double gain = saturationSpinBox->value();
+                filter = [this, gain](const QImage &image) {
+                    return processor.applySaturation(image, gain);
+                };
+                break;
+            }
+            case 9: { // Value, with the gamma setting as its curve
+                double gain = valueSpinBox->value();
+                double gamma = gammaSpinBox->value();
+                filter = [this, gain, gamma](const QImage &image) {
+                    return processor.applyValueAdjustment(image, gain, gamma);
+                };
                 break;
+            }
             default:
-                result = currentImage;
                 break;
         }
     } else if (filterType == 1) { // Convolution filters
         if (filterIndex < 5) { // Predefined filters
+            margin = 1;
             switch (filterIndex) {
                 case 0: // Blur
-                    result = processor.applyBlur(currentImage);
+                    filter = [this](const QImage &image) { return processor.applyBlur(image); };
                     break;
                 case 1: // Gaussian blur
-                    result = processor.applyGaussianBlur(currentImage);
+                    filter = [this](const QImage &image) { return processor.applyGaussianBlur(image); };
                     break;
                 case 2: // Sharpen
-                    result = processor.applySharpen(currentImage);
+                    filter = [this](const QImage &image) { return processor.applySharpen(image); };
                     break;
                 case 3: // Edge detection
-                    result = processor.applyEdgeDetection(currentImage);
+                    filter = [this](const QImage &image) { return processor.applyEdgeDetection(image); };
                     break;
                 case 4: // Emboss
-                    result = processor.applyEmboss(currentImage);
+                    filter = [this](const QImage &image) { return processor.applyEmboss(image); };
                     break;
                 default:
-                    result = currentImage;
                     break;
             }
         } else { // Custom filter
@@ -656,28 +843,112 @@ void MainWindow::applyFilter()
             double offset = offsetSpinBox->value();
             int anchorX = anchorXSpinBox->value();
             int anchorY = anchorYSpinBox->value();
+            margin = qMax(kernelTable->rowCount(), kernelTable->columnCount());
             
-            result = processor.applyConvolutionFilter(currentImage, kernel, divisor, offset, anchorX, anchorY);
+            filter = [this, kernel, divisor, offset, anchorX, anchorY](const QImage &image) {
+                return processor.applyConvolutionFilter(image, kernel, divisor, offset, anchorX, anchorY);
+            };
         }
     } else if (filterType == 2) { // Median filter
-        result = processor.applyMedianFilter(currentImage, medianSizeSpinBox->value());
+        int size = medianSizeSpinBox->value();
+        margin = size / 2;
+        filter = [this, size](const QImage &image) { return processor.applyMedianFilter(image, size); };
     }
     
+    return filter;
+}
+
+void MainWindow::startFilterJob(const QString &name, const std::function<QImage(const QImage &)> &filter)
+{
+    auto job = std::make_shared<FilterJob>();
+    auto result = std::make_shared<QImage>();
+    QImage source = currentImage;
+    
+    // Progress arrives on worker threads and is queued to the bar
+    QProgressBar *bar = progressBar;
+    job->setProgressHandler([bar](int percent) {
+        QMetaObject::invokeMethod(bar, "setValue", Qt::QueuedConnection, Q_ARG(int, percent));
+    });
+    
+    filterJob = job;
+    filterThread = QThread::create([job, result, source, filter]() {
+        FilterJob::Scope scope(job.get());
+        *result = filter(source);
+    });
+    connect(filterThread, &QThread::finished, this, [this, job, result, name]() {
+        finishFilterJob(name, job->isCancelRequested(), *result);
+    });
+    
+    setFilterRunning(true);
+    statusBar()->showMessage(tr("Applying %1...").arg(name));
+    filterThread->start();
+}
+
+void MainWindow::finishFilterJob(const QString &name, bool cancelled, const QImage &result)
+{
+    filterThread->deleteLater();
+    filterThread = nullptr;
+    filterJob.reset();
+    setFilterRunning(false);
+    
+    // The history only changes once a result replaces the current image,
+    // so a cancelled run leaves it as it was
+    if (cancelled) {
+        statusBar()->showMessage(tr("Filter cancelled: %1").arg(name), 3000);
+        return;
+    }
+    
+    // Save current image for undo
+    imageHistory.push(currentImage);
+    
     // Update display
     updateImage(result);
     
-    statusBar()->showMessage(tr("Filter applied: %1").arg(filterSelectionComboBox->currentText()), 3000);
+    statusBar()->showMessage(tr("Filter applied: %1").arg(name), 3000);
+}
+
+void MainWindow::cancelFilter()
+{
+    if (filterJob) {
+        filterJob->cancel();
+        statusBar()->showMessage(tr("Cancelling..."));
+    }
+}
+
+void MainWindow::setFilterRunning(bool running)
+{
+    enableFilterControls(!running);
+    convertToHSVButton->setEnabled(!running);
+    cancelButton->setEnabled(running);
+    progressBar->setValue(0);
+    progressBar->setVisible(running);
+    
+    // The preview is of the image the running filter replaces
+    if (running) {
+        clearPreview();
+    } else {
+        schedulePreview();
+    }
 }
 
 void MainWindow::undoFilter()
 {
+    if (filterThread) {
+        return;
+    }
+    
     if (imageHistory.isEmpty()) {
         QMessageBox::information(this, tr("Undo"), tr("Nothing to undo"));
         return;
     }
     
     // Restore previous image
-    currentImage = imageHistory.pop();
+    QImage previous = imageHistory.pop();
+    if (previous.isNull()) {
+        QMessageBox::warning(this, tr("Undo"), tr("The undo history could not be read back"));
+        return;
+    }
+    currentImage = previous;
     displayImage(currentImage);
     
     statusBar()->showMessage(tr("Undo applied"), 3000);
@@ -890,6 +1161,111 @@ void MainWindow::updateFilterPreview()
     if (autoDivisorCheckBox->isChecked()) {
         calculateDivisor();
     }
+    
+    schedulePreview();
+}
+
+void MainWindow::schedulePreview()
+{
+    if (!livePreviewCheckBox->isChecked()) {
+        return;
+    }
+    
+    // A render for the old settings is stale from now on; the new one waits
+    // until the settings stop changing
+    previewGeneration.fetchAndAddOrdered(1);
+    if (previewJob) {
+        previewJob->cancel();
+    }
+    previewTimer->start();
+}
+
+void MainWindow::renderPreview()
+{
+    int margin = 0;
+    std::function<QImage(const QImage &)> filter;
+    if (livePreviewCheckBox->isChecked() && !currentImage.isNull() && !filterThread) {
+        filter = selectedFilter(margin);
+    }
+    
+    QRect visible = visibleImageRect();
+    if (!filter || visible.isEmpty()) {
+        clearPreview();
+        return;
+    }
+    
+    // Only the visible part is filtered, so the cost follows the window and
+    // not the image. Its surroundings within the filter's reach come along,
+    // which gives the same pixels as filtering the whole image.
+    QRect source = visible.adjusted(-margin, -margin, margin, margin).intersected(currentImage.rect());
+    source.setLeft(source.left() / PreviewAlignment * PreviewAlignment);
+    source.setTop(source.top() / PreviewAlignment * PreviewAlignment);
+    QImage crop = currentImage.copy(source);
+    QRect inner = visible.translated(-source.topLeft());
+    
+    int generation = previewGeneration.fetchAndAddOrdered(1) + 1;
+    if (previewJob) {
+        previewJob->cancel();
+    }
+    auto job = std::make_shared<FilterJob>();
+    previewJob = job;
+    
+    previewPool.start([this, job, generation, filter, crop, inner, visible]() {
+        // Settings changed again while this render was queued
+        if (previewGeneration.loadAcquire() != generation) {
+            return;
+        }
+        
+        QImage result;
+        {
+            FilterJob::Scope scope(job.get());
+            result = filter(crop);
+        }
+        if (job->isCancelRequested()) {
+            return;
+        }
+        
+        QImage shown = result.copy(inner);
+        QMetaObject::invokeMethod(this, [this, generation, visible, shown]() {
+            showPreview(generation, visible, shown);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::showPreview(int generation, const QRect &area, const QImage &image)
+{
+    if (generation != previewGeneration.loadAcquire()) {
+        return;
+    }
+    
+    previewLabel->setPixmap(QPixmap::fromImage(image));
+    previewLabel->setGeometry(area.translated(imageOrigin()));
+    previewLabel->show();
+    previewLabel->raise();
+}
+
+void MainWindow::clearPreview()
+{
+    previewGeneration.fetchAndAddOrdered(1);
+    if (previewJob) {
+        previewJob->cancel();
+        previewJob.reset();
+    }
+    previewTimer->stop();
+    previewLabel->hide();
+}
+
+QPoint MainWindow::imageOrigin() const
+{
+    // imageLabel centres the image when the viewport is larger
+    return QPoint(qMax(0, (imageLabel->width() - currentImage.width()) / 2),
+                  qMax(0, (imageLabel->height() - currentImage.height()) / 2));
+}
+
+QRect MainWindow::visibleImageRect() const
+{
+    QPoint topLeft = imageLabel->mapFrom(scrollArea->viewport(), QPoint(0, 0)) - imageOrigin();
+    return QRect(topLeft, scrollArea->viewport()->size()).intersected(currentImage.rect());
 }
 
 void MainWindow::loadPredefinedFilter(int index)
@@ -941,6 +1317,10 @@ void MainWindow::displayImage(const QImage &image)
 {
     imageLabel->setPixmap(QPixmap::fromImage(image));
     imageLabel->adjustSize();
+    
+    // A preview of the previous image no longer applies
+    previewLabel->hide();
+    schedulePreview();
 }
 
 void MainWindow::enableFilterControls(bool enable)
@@ -969,6 +1349,9 @@ void MainWindow::setupFunctionFilterControls()
     filterSelectionComboBox->addItem("Grayscale");
     filterSelectionComboBox->addItem("Uniform Quantization");
     filterSelectionComboBox->addItem("Dithering");
+    filterSelectionComboBox->addItem("Hue Rotation");
+    filterSelectionComboBox->addItem("Saturation");
+    filterSelectionComboBox->addItem("Value");
     
     // Show function parameters, hide other parameters
     functionParamsGroup->setVisible(true);
@@ -1159,8 +1542,8 @@ void MainWindow::convertToHSV()
     // Store original image for comparison
     QImage originalRGB = currentImage;
     
-    // Convert to HSV
-    QImage hsvImage = processor.convertToHSV(currentImage);
+    // Convert to HSV; the channels are views of its planes
+    HsvImage hsvImage = processor.convertToHSV(currentImage);
     QImage hueImage = processor.getHueChannel(hsvImage);
     QImage saturationImage = processor.getSaturationChannel(hsvImage);
     QImage valueImage = processor.getValueChannel(hsvImage);
@@ -1192,10 +1575,14 @@ void MainWindow::convertToHSV()
     const int threshold = 1;
     int maxDiff = 0;
     
-    for (int y = 0; y < originalRGB.height(); ++y) {
-        for (int x = 0; x < originalRGB.width(); ++x) {
-            QRgb origPixel = originalRGB.pixel(x, y);
-            QRgb convPixel = convertedRGB.pixel(x, y);
+    ConstPixelView origView(originalRGB);
+    ConstPixelView convView(convertedRGB);
+    for (int y = 0; y < origView.height(); ++y) {
+        const QRgb *origRow = origView.row(y);
+        const QRgb *convRow = convView.row(y);
+        for (int x = 0; x < origView.width(); ++x) {
+            QRgb origPixel = origRow[x];
+            QRgb convPixel = convRow[x];
             
             // Calculate differences for each channel
             int rDiff = std::abs(qRed(origPixel) - qRed(convPixel));